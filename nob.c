@@ -57,6 +57,7 @@ int main(int argc, char **argv)
         SRC_FOLDER"flags.c",
         SRC_FOLDER"hud.c",
         SRC_FOLDER"arena.c",
+        SRC_FOLDER"timing.c",
         SRC_FOLDER"player.c",
         SRC_FOLDER"physics.c"
     );
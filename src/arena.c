@@ -7,23 +7,50 @@ void arena_init(Arena *arena, size_t capacity) {
     arena->buffer   = (uint8_t *)malloc(capacity);
     arena->offset   = 0;
     arena->capacity = capacity;
+    arena->peak     = 0;
     assert(arena->buffer != NULL);
 }
 
-void *arena_alloc(Arena *arena, size_t size) {
+void *arena_try_alloc(Arena *arena, size_t size) {
     size_t aligned_offset = (arena->offset + 15) & ~(size_t)15;
-    if (aligned_offset + size > arena->capacity) {
-        fprintf(stderr, "Arena out of memory: requested %zu, available %zu\n",
-                size, arena->capacity - aligned_offset);
-        return NULL;
-    }
+    if (aligned_offset + size > arena->peak) arena->peak = aligned_offset + size;
+    if (aligned_offset + size > arena->capacity) return NULL;
     void *ptr = arena->buffer + aligned_offset;
     arena->offset = aligned_offset + size;
     return ptr;
 }
 
+void *arena_alloc(Arena *arena, size_t size) {
+    void *ptr = arena_try_alloc(arena, size);
+    if (!ptr) {
+        fprintf(stderr, "Arena out of memory: requested %zu, available %zu\n",
+                size, arena_available(arena));
+    }
+    return ptr;
+}
+
+size_t arena_available(const Arena *arena) {
+    size_t aligned_offset = (arena->offset + 15) & ~(size_t)15;
+    return aligned_offset < arena->capacity ? arena->capacity - aligned_offset : 0;
+}
+
 void arena_reset(Arena *arena) {
     arena->offset = 0;
+    arena->peak   = 0;
+}
+
+void arena_reset_fit(Arena *arena) {
+    size_t capacity = arena->capacity;
+    while (arena->peak > capacity - capacity / 4) capacity *= 2;
+    if (capacity > arena->capacity) {
+        uint8_t *buffer = (uint8_t *)malloc(capacity);
+        if (buffer) {
+            free(arena->buffer);
+            arena->buffer   = buffer;
+            arena->capacity = capacity;
+        }
+    }
+    arena_reset(arena);
 }
 
 void arena_free(Arena *arena) {
@@ -31,4 +58,5 @@ void arena_free(Arena *arena) {
     arena->buffer   = NULL;
     arena->offset   = 0;
     arena->capacity = 0;
+    arena->peak     = 0;
 }
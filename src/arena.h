@@ -5,17 +5,27 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define FRAME_ARENA_SIZE (4 * 1024 * 1024)
+#define FRAME_ARENA_SIZE (16 * 1024 * 1024)
 
 typedef struct {
     uint8_t *buffer;
     size_t   offset;
     size_t   capacity;
+    size_t   peak;      // bytes asked for since the last reset, fitting or not
 } Arena;
 
 void  arena_init(Arena *arena, size_t capacity);
 void *arena_alloc(Arena *arena, size_t size);
+// Like arena_alloc() but returns NULL quietly, for callers with a fallback.
+// A request that does not fit still counts toward peak.
+void *arena_try_alloc(Arena *arena, size_t size);
+// Largest request arena_alloc() can still satisfy
+size_t arena_available(const Arena *arena);
 void  arena_reset(Arena *arena);
+// Resets the arena, first growing it when the last cycle's peak came
+// within a quarter of its capacity or overflowed it. Only safe while
+// nothing allocated from it is in use.
+void  arena_reset_fit(Arena *arena);
 void  arena_free(Arena *arena);
 
 #endif // ARENA_H
@@ -1,17 +1,122 @@
 #include "chunk.h"
-#include <stdlib.h>
+#include "display.h"
+#include <string.h>
 #include <math.h>
 
-static int chunk_compare(const void *a, const void *b) {
-    float da = ((const Chunk *)a)->depth_sort_key;
-    float db = ((const Chunk *)b)->depth_sort_key;
-    if (da < db) return -1;
-    if (da > db) return  1;
-    return 0;
+// Bytes per chunk across the four arrays. They share one allocation,
+// widest alignment first.
+#define CHUNK_STREAM_STRIDE \
+    (sizeof(Chunk) + 2 * sizeof(uint64_t) + sizeof(float) + sizeof(ChunkBounds))
+
+bool chunk_stream_init(ChunkStream *stream, Arena *arena, int capacity) {
+    memset(stream, 0, sizeof(*stream));
+    uint8_t *block = arena_try_alloc(arena, (size_t)capacity * CHUNK_STREAM_STRIDE);
+    if (!block) {
+        // The failed request still told the arena how much the frame
+        // wanted; take what fits now and let it grow for the next one
+        capacity = (int)(arena_available(arena) / CHUNK_STREAM_STRIDE);
+        block = capacity > 0 ? arena_try_alloc(arena, (size_t)capacity * CHUNK_STREAM_STRIDE) : NULL;
+        if (!block) return false;
+    }
+    stream->chunks    = (Chunk *)block;
+    stream->sort_keys = (uint64_t *)(stream->chunks + capacity);
+    stream->depth     = (float *)(stream->sort_keys + 2 * (size_t)capacity);
+    stream->bounds    = (ChunkBounds *)(stream->depth + capacity);
+    stream->capacity  = capacity;
+    return true;
+}
+
+void chunk_stream_commit(ChunkStream *stream) {
+    int i = stream->count++;
+    const Chunk *chunk = &stream->chunks[i];
+    stream->depth[i] = minf(chunk->verts[0].z, minf(chunk->verts[1].z, chunk->verts[2].z));
+
+    ScreenAABB bb = chunk_screen_aabb(chunk);
+    stream->bounds[i] = (ChunkBounds){
+        .x_min = (int16_t)clampi(bb.x_min, 0, WINDOW_WIDTH),
+        .x_max = (int16_t)clampi(bb.x_max, 0, WINDOW_WIDTH),
+        .y_min = (int16_t)clampi(bb.y_min, 0, WINDOW_HEIGHT),
+        .y_max = (int16_t)clampi(bb.y_max, 0, WINDOW_HEIGHT),
+    };
 }
 
-void chunks_sort_front_to_back(Chunk *chunks, int count) {
-    qsort(chunks, count, sizeof(Chunk), chunk_compare);
+// Flips float bits so unsigned order matches float order: negatives get
+// every bit inverted, positives just the sign. Adding zero first folds
+// -0 into +0, which compare equal as floats.
+static inline uint32_t chunk_sort_bits(float depth) {
+    float f = depth + 0.0f;
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u ^ ((u >> 31) ? 0xFFFFFFFFu : 0x80000000u);
+}
+
+// Moves each chunk to its sorted slot by following the permutation's
+// cycles, so every chunk is copied about once and no second array of
+// chunks is needed. The low half of keys[i] names the chunk that belongs
+// at i, and is pointed back at i once it is there.
+static void chunk_stream_permute(ChunkStream *s, uint64_t *keys) {
+    for (int i = 0; i < s->count; i++) {
+        if ((uint32_t)keys[i] == (uint32_t)i) continue;
+        Chunk       held_chunk  = s->chunks[i];
+        float       held_depth  = s->depth[i];
+        ChunkBounds held_bounds = s->bounds[i];
+        int at = i;
+        while ((uint32_t)keys[at] != (uint32_t)i) {
+            int from = (int)(uint32_t)keys[at];
+            s->chunks[at] = s->chunks[from];
+            s->depth[at]  = s->depth[from];
+            s->bounds[at] = s->bounds[from];
+            keys[at] = (uint64_t)at;
+            at = from;
+        }
+        s->chunks[at] = held_chunk;
+        s->depth[at]  = held_depth;
+        s->bounds[at] = held_bounds;
+        keys[at] = (uint64_t)at;
+    }
+}
+
+// Least-significant-digit radix sort of (key << 32 | index) words on the
+// key bytes only, so equal keys keep their order. All four histograms
+// come from one read of the depths, and a pass whose digit is the same
+// for every key is skipped.
+void chunks_sort_front_to_back(ChunkStream *stream) {
+    int count = stream->count;
+    if (count < 2) return;
+
+    uint64_t *keys = stream->sort_keys;
+    uint64_t *temp = stream->sort_keys + count;
+
+    int histogram[4][256] = {{0}};
+    for (int i = 0; i < count; i++) {
+        uint32_t k = chunk_sort_bits(stream->depth[i]);
+        keys[i] = ((uint64_t)k << 32) | (uint32_t)i;
+        histogram[0][k & 0xFF]++;
+        histogram[1][(k >> 8) & 0xFF]++;
+        histogram[2][(k >> 16) & 0xFF]++;
+        histogram[3][k >> 24]++;
+    }
+
+    for (int pass = 0; pass < 4; pass++) {
+        int shift = 32 + pass * 8;
+        int *h = histogram[pass];
+        if (h[(keys[0] >> shift) & 0xFF] == count) continue;
+
+        int sum = 0;
+        for (int d = 0; d < 256; d++) {
+            int n = h[d];
+            h[d] = sum;
+            sum += n;
+        }
+        for (int i = 0; i < count; i++) {
+            temp[h[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        }
+        uint64_t *swap = keys;
+        keys = temp;
+        temp = swap;
+    }
+
+    chunk_stream_permute(stream, keys);
 }
 
 ScreenAABB chunk_screen_aabb(const Chunk *chunk) {
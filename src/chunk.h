@@ -2,17 +2,43 @@
 #define CHUNK_H
 
 #include "math_utils.h"
+#include "arena.h"
 #include <stdint.h>
+#include <stdbool.h>
 
-typedef struct {
-    uint32_t *pixels;
-    int       width;
-    int       height;
+// Textures loaded for the scene keep their texels in TEXTURE_BLOCK-square
+// blocks, row-major within each block and across blocks, so a block fills
+// one cache line and sampling stays local whichever way V and U move.
+// The block grid is padded up to whole blocks.
+typedef struct Texture {
+    uint32_t       *pixels;
+    int             width;
+    int             height;
+    bool            pow2;  // width and height are both powers of two
+    struct Texture *mip;   // next level at half size, NULL after the last
 } Texture;
 
+#define TEXTURE_BLOCK_BITS 2
+#define TEXTURE_BLOCK      (1 << TEXTURE_BLOCK_BITS)
+
+static inline int texture_blocks_x(const Texture *tex) {
+    return (tex->width + TEXTURE_BLOCK - 1) >> TEXTURE_BLOCK_BITS;
+}
+
+static inline int texture_blocks_y(const Texture *tex) {
+    return (tex->height + TEXTURE_BLOCK - 1) >> TEXTURE_BLOCK_BITS;
+}
+
+static inline int texture_offset(const Texture *tex, int x, int y) {
+    int block = (y >> TEXTURE_BLOCK_BITS) * texture_blocks_x(tex) + (x >> TEXTURE_BLOCK_BITS);
+    int inner = ((y & (TEXTURE_BLOCK - 1)) << TEXTURE_BLOCK_BITS) | (x & (TEXTURE_BLOCK - 1));
+    return (block << (2 * TEXTURE_BLOCK_BITS)) | inner;
+}
+
 typedef enum {
     CHUNK_COLORED,
     CHUNK_TEXTURED,
+    CHUNK_TYPE_COUNT,
 } ChunkType;
 
 typedef struct {
@@ -24,7 +50,6 @@ typedef struct {
 typedef struct {
     ChunkType    type;
     ScreenVertex verts[3];
-    float        depth_sort_key;
 
     union {
         struct {
@@ -43,7 +68,42 @@ typedef struct {
     int y_min, y_max;
 } ScreenAABB;
 
-void       chunks_sort_front_to_back(Chunk *chunks, int count);
-ScreenAABB chunk_screen_aabb(const Chunk *chunk);
+// A chunk's screen bounding box clipped to the window, max exclusive;
+// empty when the chunk is entirely off screen
+typedef struct {
+    int16_t x_min, x_max;
+    int16_t y_min, y_max;
+} ChunkBounds;
+
+// A frame's chunks as parallel arrays. The rasterizers read whole Chunk
+// records, but sorting and binning need only a key and a box per chunk,
+// so those live in arrays of their own and stream 4 and 8 bytes a chunk
+// instead of an 88-byte record. Index i names the same chunk in each.
+typedef struct {
+    Chunk       *chunks;
+    float       *depth;      // nearest vertex depth, the sort key
+    ChunkBounds *bounds;
+    uint64_t    *sort_keys;  // radix sort scratch, two per chunk; NULL if never sorted
+    int          count;
+    int          capacity;
+    int          dropped;    // chunks generated past capacity and thrown away
+} ChunkStream;
+
+// Running account of ChunkStream.dropped across frames
+typedef struct {
+    int     frames;  // frames that dropped any
+    int64_t total;
+} ChunkDrops;
+
+// Carves arrays for capacity chunks, and sort scratch, out of the arena.
+// When that does not fit the capacity shrinks to what does; returns false,
+// with the stream empty and unusable, only when not even one chunk fits.
+bool        chunk_stream_init(ChunkStream *stream, Arena *arena, int capacity);
+// Fills in depth and bounds for the chunk just written at stream->count
+// and counts it
+void        chunk_stream_commit(ChunkStream *stream);
+// Stable in depth; the stream needs its sort scratch
+void        chunks_sort_front_to_back(ChunkStream *stream);
+ScreenAABB  chunk_screen_aabb(const Chunk *chunk);
 
 #endif // CHUNK_H
@@ -1,8 +1,14 @@
 #include "display.h"
 #include <SDL2/SDL.h>
 
-uint32_t display_buffer[WINDOW_WIDTH * WINDOW_HEIGHT];
-float    zbuf[WINDOW_WIDTH * WINDOW_HEIGHT];
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+uint32_t  display_buffer[WINDOW_WIDTH * WINDOW_HEIGHT];
+float     zbuf[WINDOW_WIDTH * WINDOW_HEIGHT];
+float     zbuf_tile_max[ZBUF_TILES_X * ZBUF_TILES_Y];
+VisRecord vis_buffer[WINDOW_WIDTH * WINDOW_HEIGHT];
 
 static SDL_Window   *window;
 static SDL_Renderer *sdl_renderer;
@@ -36,10 +42,44 @@ bool display_init(void) {
     return true;
 }
 
+#define CLEAR_PREFETCH_ROWS 4
+
 void display_clear(uint32_t background_color) {
-    for (int i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
-        display_buffer[i] = background_color;
-        zbuf[i] = 1.0f;
+    display_clear_rect(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT, background_color);
+}
+
+void display_clear_rect(int x_min, int x_max, int y_min, int y_max, uint32_t background_color) {
+    for (int y = y_min; y < y_max; y++) {
+        uint32_t *row  = &display_buffer[y * WINDOW_WIDTH];
+        float    *zrow = &zbuf[y * WINDOW_WIDTH];
+
+        // Short rows defeat the hardware prefetcher; fetch a few rows ahead
+        if (y + CLEAR_PREFETCH_ROWS < y_max) {
+            for (int x = x_min; x < x_max; x += 16) {
+                __builtin_prefetch(&row[x + CLEAR_PREFETCH_ROWS * WINDOW_WIDTH], 1);
+                __builtin_prefetch(&zrow[x + CLEAR_PREFETCH_ROWS * WINDOW_WIDTH], 1);
+            }
+        }
+
+        int x = x_min;
+#if defined(__SSE2__)
+        __m128i color = _mm_set1_epi32((int)background_color);
+        __m128  depth = _mm_set1_ps(1.0f);
+        for (; x + 4 <= x_max; x += 4) {
+            _mm_storeu_si128((__m128i *)&row[x], color);
+            _mm_storeu_ps(&zrow[x], depth);
+        }
+#endif
+        for (; x < x_max; x++) {
+            row[x]  = background_color;
+            zrow[x] = 1.0f;
+        }
+    }
+
+    for (int ty = y_min / ZBUF_TILE_SIZE; ty * ZBUF_TILE_SIZE < y_max; ty++) {
+        for (int tx = x_min / ZBUF_TILE_SIZE; tx * ZBUF_TILE_SIZE < x_max; tx++) {
+            zbuf_tile_max[ty * ZBUF_TILES_X + tx] = 1.0f;
+        }
     }
 }
 
@@ -9,8 +9,25 @@
 #define DISPLAY_WIDTH  WINDOW_WIDTH
 #define DISPLAY_HEIGHT WINDOW_HEIGHT
 
-extern uint32_t display_buffer[];
-extern float    zbuf[];
+// Hierarchical depth: the farthest depth stored in each tile of zbuf,
+// kept as a conservative upper bound by the rasterizers
+#define ZBUF_TILE_SIZE 8
+#define ZBUF_TILES_X   ((WINDOW_WIDTH  + ZBUF_TILE_SIZE - 1) / ZBUF_TILE_SIZE)
+#define ZBUF_TILES_Y   ((WINDOW_HEIGHT + ZBUF_TILE_SIZE - 1) / ZBUF_TILE_SIZE)
+
+// Visibility buffer: the nearest chunk at each pixel and its screen-space
+// barycentrics, shaded in a separate resolve pass
+typedef struct {
+    uint32_t chunk;
+    float    b1, b2;
+} VisRecord;
+
+#define VIS_NONE UINT32_MAX
+
+extern uint32_t  display_buffer[];
+extern float     zbuf[];
+extern float     zbuf_tile_max[];
+extern VisRecord vis_buffer[];
 
 #define COLOR_ARGB(a, r, g, b) \
     (((uint32_t)(a) << 24) | ((uint32_t)(r) << 16) | \
@@ -20,6 +37,9 @@ extern float    zbuf[];
 
 bool display_init(void);
 void display_clear(uint32_t background_color);
+// Color, depth and hi-Z for [x_min, x_max) x [y_min, y_max); the rect must
+// lie on the ZBUF_TILE_SIZE grid so no tile is reset for pixels kept
+void display_clear_rect(int x_min, int x_max, int y_min, int y_max, uint32_t background_color);
 void display_present(void);
 void display_destroy(void);
 
@@ -1,5 +1,8 @@
 #include "flags.h"
 #include "display.h"
+#include "raster.h"
+#include "strip.h"
+#include <stdlib.h>
 #include <string.h>
 
 GameFlags g_flags = {
@@ -11,6 +14,23 @@ GameFlags g_flags = {
     .show_chunk_borders = false,
     .third_person       = false,
     .gravity_enabled    = true,
+    .simd_enabled       = true,
+    .tile_raster        = true,
+    .hiz_enabled        = true,
+    .depth_prepass      = false,
+    .vis_buffer         = false,
+    .mipmaps            = true,
+    .pow2_textures      = true,
+    .work_stealing      = true,
+    .balance_strips     = true,
+    .parallel_chunks    = true,
+    .pipelined          = false,
+    .spin_dispatch      = false,
+    .main_assists       = false,
+    .pin_threads        = false,
+    .fused_clear        = true,
+    .frustum_cull       = true,
+    .render_threads     = 0,
 };
 
 Camera *g_camera = NULL;
@@ -94,6 +114,256 @@ static void cmd_gravity(int argc, const char **argv) {
     }
 }
 
+static void cmd_simd(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.simd_enabled = !g_flags.simd_enabled;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.simd_enabled = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.simd_enabled = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "simd: %s (%s)",
+                      g_flags.simd_enabled ? "ON" : "OFF", raster_simd_name());
+    }
+}
+
+static void cmd_tiles(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.tile_raster = !g_flags.tile_raster;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.tile_raster = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.tile_raster = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "tiles: %s",
+                      g_flags.tile_raster ? "ON" : "OFF");
+    }
+}
+
+static void cmd_hiz(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.hiz_enabled = !g_flags.hiz_enabled;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.hiz_enabled = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.hiz_enabled = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "hiz: %s%s",
+                      g_flags.hiz_enabled ? "ON" : "OFF",
+                      g_flags.tile_raster ? "" : " (needs tiles)");
+    }
+}
+
+static void cmd_prepass(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.depth_prepass = !g_flags.depth_prepass;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.depth_prepass = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.depth_prepass = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "prepass: %s",
+                      g_flags.depth_prepass ? "ON" : "OFF");
+    }
+}
+
+static void cmd_visbuf(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.vis_buffer = !g_flags.vis_buffer;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.vis_buffer = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.vis_buffer = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "visbuf: %s",
+                      g_flags.vis_buffer ? "ON" : "OFF");
+    }
+}
+
+static void cmd_mip(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.mipmaps = !g_flags.mipmaps;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.mipmaps = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.mipmaps = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "mip: %s",
+                      g_flags.mipmaps ? "ON" : "OFF");
+    }
+}
+
+static void cmd_pow2(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.pow2_textures = !g_flags.pow2_textures;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.pow2_textures = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.pow2_textures = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "pow2: %s",
+                      g_flags.pow2_textures ? "ON" : "OFF");
+    }
+}
+
+static void cmd_steal(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.work_stealing = !g_flags.work_stealing;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.work_stealing = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.work_stealing = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "steal: %s",
+                      g_flags.work_stealing ? "ON" : "OFF");
+    }
+}
+
+static void cmd_balance(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.balance_strips = !g_flags.balance_strips;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.balance_strips = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.balance_strips = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "balance: %s",
+                      g_flags.balance_strips ? "ON" : "OFF");
+    }
+}
+
+static void cmd_pargen(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.parallel_chunks = !g_flags.parallel_chunks;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.parallel_chunks = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.parallel_chunks = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "pargen: %s",
+                      g_flags.parallel_chunks ? "ON" : "OFF");
+    }
+}
+
+static void cmd_pipeline(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.pipelined = !g_flags.pipelined;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.pipelined = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.pipelined = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "pipeline: %s",
+                      g_flags.pipelined ? "ON" : "OFF");
+    }
+}
+
+static void cmd_spin(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.spin_dispatch = !g_flags.spin_dispatch;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.spin_dispatch = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.spin_dispatch = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "spin: %s",
+                      g_flags.spin_dispatch ? "ON" : "OFF");
+    }
+}
+
+static void cmd_assist(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.main_assists = !g_flags.main_assists;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.main_assists = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.main_assists = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "assist: %s",
+                      g_flags.main_assists ? "ON" : "OFF");
+    }
+}
+
+static void cmd_pin(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.pin_threads = !g_flags.pin_threads;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.pin_threads = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.pin_threads = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "pin: %s",
+                      g_flags.pin_threads ? "ON" : "OFF");
+    }
+}
+
+static void cmd_fuseclear(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.fused_clear = !g_flags.fused_clear;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.fused_clear = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.fused_clear = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "fuseclear: %s",
+                      g_flags.fused_clear ? "ON" : "OFF");
+    }
+}
+
+static void cmd_cull(int argc, const char **argv) {
+    if (argc < 2) {
+        g_flags.frustum_cull = !g_flags.frustum_cull;
+    } else if (strcmp(argv[1], "on") == 0) {
+        g_flags.frustum_cull = true;
+    } else if (strcmp(argv[1], "off") == 0) {
+        g_flags.frustum_cull = false;
+    }
+    if (g_console) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "cull: %s",
+                      g_flags.frustum_cull ? "ON" : "OFF");
+    }
+}
+
+static void cmd_threads(int argc, const char **argv) {
+    if (!g_console) return;
+
+    if (argc >= 2) {
+        long n = 0;
+        if (strcmp(argv[1], "auto") != 0) {
+            // strtol saturates out-of-range input, which the bounds then reject
+            char *end;
+            n = strtol(argv[1], &end, 10);
+            if (end == argv[1] || *end != '\0' || n < 1 || n > STRIP_MAX_THREADS) {
+                console_printf(g_console, COLOR_RGB(200, 200, 200),
+                              "Usage: threads <1-%d|auto>", STRIP_MAX_THREADS);
+                return;
+            }
+        }
+        g_flags.render_threads = (int)n;
+    }
+    if (g_flags.render_threads > 0) {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "threads: %d", g_flags.render_threads);
+    } else {
+        console_printf(g_console, COLOR_RGB(255, 255, 0), "threads: auto (%d)",
+                      strip_pool_cpu_count());
+    }
+}
+
 void flags_register_commands(Console *con) {
     console_register_command(con, "fog",       "Toggle fog rendering",    cmd_fog);
     console_register_command(con, "fly",       "Toggle fly mode",         cmd_fly);
@@ -102,4 +372,21 @@ void flags_register_commands(Console *con) {
     console_register_command(con, "zbuffer",   "Show depth buffer",       cmd_zbuffer);
     console_register_command(con, "thirdperson", "Toggle third-person view", cmd_thirdperson);
     console_register_command(con, "gravity",   "Toggle gravity [on|off]", cmd_gravity);
+    console_register_command(con, "simd",      "Toggle SIMD raster kernels [on|off]", cmd_simd);
+    console_register_command(con, "tiles",     "Toggle 8x8 tile rasterization [on|off]", cmd_tiles);
+    console_register_command(con, "hiz",       "Toggle hierarchical depth rejection [on|off]", cmd_hiz);
+    console_register_command(con, "prepass",   "Toggle depth pre-pass [on|off]", cmd_prepass);
+    console_register_command(con, "visbuf",    "Toggle visibility buffer rendering [on|off]", cmd_visbuf);
+    console_register_command(con, "mip",       "Toggle per-triangle mip level selection [on|off]", cmd_mip);
+    console_register_command(con, "pow2",      "Toggle the power-of-two texture fast path [on|off]", cmd_pow2);
+    console_register_command(con, "steal",     "Toggle work-stealing tiles instead of fixed strips [on|off]", cmd_steal);
+    console_register_command(con, "balance",   "Toggle resizing strips from last frame's render times [on|off]", cmd_balance);
+    console_register_command(con, "pargen",    "Toggle generating chunks on the worker threads [on|off]", cmd_pargen);
+    console_register_command(con, "pipeline",  "Toggle rendering a frame while the next is generated, one frame of extra latency [on|off]", cmd_pipeline);
+    console_register_command(con, "spin",      "Toggle spinning briefly before sleeping between worker jobs [on|off]", cmd_spin);
+    console_register_command(con, "assist",    "Toggle the main thread rendering a share instead of waiting [on|off]", cmd_assist);
+    console_register_command(con, "pin",       "Toggle binding each worker thread to one CPU (Linux) [on|off]", cmd_pin);
+    console_register_command(con, "threads",   "Set the number of worker lanes [n|auto]", cmd_threads);
+    console_register_command(con, "fuseclear", "Toggle workers clearing their own regions instead of one full-screen clear [on|off]", cmd_fuseclear);
+    console_register_command(con, "cull",      "Toggle skipping objects whose bounding sphere is outside the view [on|off]", cmd_cull);
 }
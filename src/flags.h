@@ -14,6 +14,23 @@ typedef struct {
     bool show_chunk_borders;
     bool third_person;
     bool gravity_enabled;
+    bool simd_enabled;
+    bool tile_raster;
+    bool hiz_enabled;
+    bool depth_prepass;
+    bool vis_buffer;
+    bool mipmaps;
+    bool pow2_textures;
+    bool work_stealing;
+    bool balance_strips;
+    bool parallel_chunks;
+    bool pipelined;
+    bool spin_dispatch;
+    bool main_assists;
+    bool pin_threads;
+    bool fused_clear;
+    bool frustum_cull;
+    int  render_threads;  // worker lanes, 0 for one per available CPU
 } GameFlags;
 
 extern GameFlags g_flags;
@@ -16,6 +16,10 @@ void hud_handle_input(HUD *hud, const InputState *input) {
         hud->strip_overlay.active = !hud->strip_overlay.active;
         hud->strip_overlay.dirty = true;
     }
+    if (input_was_key_pressed(input, SDL_SCANCODE_F5)) {
+        hud->timing_overlay.active = !hud->timing_overlay.active;
+        hud->timing_overlay.dirty = true;
+    }
 }
 
 void hud_render_flags(const GlyphCache *cache, const GameFlags *flags) {
@@ -41,7 +45,7 @@ void hud_render_flags(const GlyphCache *cache, const GameFlags *flags) {
 }
 
 void hud_render_debug(const GlyphCache *cache, float fps,
-                       const Camera *cam, int chunk_count) {
+                       const Camera *cam, int chunk_count, int culled_objects) {
     int y = 4;
     int x = WINDOW_WIDTH - 30 * cache->glyph_width;
     uint32_t color = COLOR_RGB(255, 255, 255);
@@ -59,6 +63,9 @@ void hud_render_debug(const GlyphCache *cache, float fps,
     text_draw_string(cache, buf, x, y, color); y += cache->glyph_height + 2;
 
     snprintf(buf, sizeof(buf), "Chunks: %d", chunk_count);
+    text_draw_string(cache, buf, x, y, color); y += cache->glyph_height + 2;
+
+    snprintf(buf, sizeof(buf), "Culled objects: %d", culled_objects);
     text_draw_string(cache, buf, x, y, color);
 }
 
@@ -69,14 +76,58 @@ void hud_render_strips(const GlyphCache *cache, const StripPool *pool) {
 
     for (int i = 0; i < pool->strip_count; i++) {
         char buf[64];
-        snprintf(buf, sizeof(buf), "Strip %d: %d chunks [%d-%d]",
-                 i, pool->strips[i].bucket_count,
-                 pool->strips[i].x_start, pool->strips[i].x_end);
+        if (pool->stealing) {
+            const StripQueue *q = &pool->queues[i];
+            snprintf(buf, sizeof(buf), "Worker %d: %d chunks, %d tiles (%d stolen) %.2f ms",
+                     i, q->chunks_rendered, q->tiles_rendered, q->tiles_stolen,
+                     q->render_time * 1000.0);
+        } else {
+            snprintf(buf, sizeof(buf), "Strip %d: %d chunks [%d-%d] %.2f ms",
+                     i, pool->strips[i].bucket_count,
+                     pool->strips[i].x_start, pool->strips[i].x_end,
+                     pool->strips[i].render_time * 1000.0);
+        }
         text_draw_string(cache, buf, x, y, color);
         y += cache->glyph_height + 2;
     }
 }
 
+// Below the F3 block, in milliseconds over the last TIMING_HISTORY frames
+void hud_render_timings(const GlyphCache *cache, const FrameTimings *timings) {
+    int line = cache->glyph_height + 2;
+    int y = 4 + 6 * line;
+    int x = WINDOW_WIDTH - 36 * cache->glyph_width;
+    uint32_t color = COLOR_RGB(180, 220, 255);
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%-11s %7s %7s %7s", "stage ms", "min", "avg", "p99");
+    text_draw_string(cache, buf, x, y, color); y += line;
+
+    for (int s = 0; s < TIMING_STAGE_COUNT; s++) {
+        TimingStats st = timing_stats(timings, (TimingStage)s);
+        snprintf(buf, sizeof(buf), "%-11s %7.2f %7.2f %7.2f", timing_stage_name((TimingStage)s),
+                 st.min * 1000.0, st.avg * 1000.0, st.p99 * 1000.0);
+        text_draw_string(cache, buf, x, y, color); y += line;
+    }
+}
+
+void hud_render_warnings(const GlyphCache *cache, const StripPool *pool, const ChunkDrops *drops) {
+    char buf[64];
+    int y = 4;
+    if (pool->bucket_spills > 0) {
+        snprintf(buf, sizeof(buf), "Strip buckets spilled: %d frames", pool->bucket_spills);
+        int x = (WINDOW_WIDTH - (int)strlen(buf) * cache->glyph_width) / 2;
+        text_draw_string(cache, buf, x, y, COLOR_RGB(255, 100, 100));
+        y += cache->glyph_height + 2;
+    }
+    if (drops->total > 0) {
+        snprintf(buf, sizeof(buf), "Chunks dropped: %lld in %d frames",
+                 (long long)drops->total, drops->frames);
+        int x = (WINDOW_WIDTH - (int)strlen(buf) * cache->glyph_width) / 2;
+        text_draw_string(cache, buf, x, y, COLOR_RGB(255, 100, 100));
+    }
+}
+
 void hud_render_zbuffer_viz(void) {
     // Find the actual depth range of rendered pixels for better contrast
     float d_min = 1.0f, d_max = 0.0f;
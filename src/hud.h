@@ -6,6 +6,7 @@
 #include "camera.h"
 #include "flags.h"
 #include "strip.h"
+#include "timing.h"
 
 typedef struct {
     bool active;
@@ -16,13 +17,17 @@ typedef struct {
     OverlayState flags_overlay;
     OverlayState debug_overlay;
     OverlayState strip_overlay;
+    OverlayState timing_overlay;
 } HUD;
 
 void hud_handle_input(HUD *hud, const InputState *input);
 void hud_render_flags(const GlyphCache *cache, const GameFlags *flags);
 void hud_render_debug(const GlyphCache *cache, float fps,
-                       const Camera *cam, int chunk_count);
+                       const Camera *cam, int chunk_count, int culled_objects);
 void hud_render_strips(const GlyphCache *cache, const StripPool *pool);
+void hud_render_timings(const GlyphCache *cache, const FrameTimings *timings);
+// Always drawn: limits the renderer hit, if any
+void hud_render_warnings(const GlyphCache *cache, const StripPool *pool, const ChunkDrops *drops);
 void hud_render_zbuffer_viz(void);
 
 #endif // HUD_H
@@ -1,7 +1,6 @@
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <string.h>
-#include <unistd.h>
 
 #include "math_utils.h"
 #include "arena.h"
@@ -18,6 +17,7 @@
 #include "hud.h"
 #include "player.h"
 #include "physics.h"
+#include "timing.h"
 
 static Camera     camera;
 static Scene      scene;
@@ -25,11 +25,61 @@ static Console    console;
 static HUD        hud;
 static Player     player;
 static GlyphCache glyph_cache;
-static Arena      frame_arena;
+static Arena      frame_arenas[2];  // pipelined frames alternate between these
 static StripPool    strip_pool;
 static InputState   input_state;
 static PhysicsWorld physics_world;
 static Model       *stone_model;
+static FrameTimings timings;
+static ChunkDrops   chunk_drops;
+
+// Overlays and present for a frame whose render has finished
+static void finish_frame(float fps, int chunk_count, int culled_objects) {
+    double mark = timing_now();
+    // A fused clear runs inside the workers' render, so the main thread
+    // never sees it; report the busiest lane's share instead
+    double clear_time;
+    timing_set(&timings, TIMING_RASTER_MAX, strip_pool_busiest_lane(&strip_pool, &clear_time));
+    if (strip_pool.clear) {
+        timing_set(&timings, TIMING_CLEAR, clear_time);
+    }
+
+    // --- 6. Z-BUFFER VISUALIZATION ---
+    if (g_flags.show_zbuffer) {
+        hud_render_zbuffer_viz();
+    }
+
+    // --- 7. OVERLAY COMPOSITING ---
+    if (hud.flags_overlay.active) {
+        hud_render_flags(&glyph_cache, &g_flags);
+    }
+    if (hud.debug_overlay.active) {
+        hud_render_debug(&glyph_cache, fps, &camera, chunk_count, culled_objects);
+    }
+    if (hud.strip_overlay.active) {
+        hud_render_strips(&glyph_cache, &strip_pool);
+    }
+    if (hud.timing_overlay.active) {
+        hud_render_timings(&glyph_cache, &timings);
+    }
+    hud_render_warnings(&glyph_cache, &strip_pool, &chunk_drops);
+    if (console.open) {
+        console_render(&console, &glyph_cache);
+    }
+    mark = timing_mark(&timings, TIMING_OVERLAYS, mark);
+
+    // --- 8. PRESENT ---
+    display_present();
+    timing_mark(&timings, TIMING_PRESENT, mark);
+}
+
+// Joins the frame the workers were rasterizing and presents it
+static void finish_pending_frame(float fps, int chunk_count, int culled_objects) {
+    double mark = timing_now();
+    strip_pool_wait(&strip_pool);
+    timing_mark(&timings, TIMING_RENDER, mark);
+    finish_frame(fps, chunk_count, culled_objects);
+}
 
 int main(int argc, char *argv[]) {
     (void)argc; (void)argv;
@@ -61,14 +111,18 @@ int main(int argc, char *argv[]) {
     // 6b. Physics
     physics_init(&physics_world);
 
+    // 6c. Rasterizer (pick SIMD kernels for this CPU)
+    raster_init();
+
     // 7. Arena allocator
-    arena_init(&frame_arena, FRAME_ARENA_SIZE);
+    arena_init(&frame_arenas[0], FRAME_ARENA_SIZE);
+    arena_init(&frame_arenas[1], FRAME_ARENA_SIZE);
+
+    timing_init(&timings);
 
     // 8. Thread pool
-    int num_cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
-    if (num_cores < 1) num_cores = 4;
-    if (num_cores > 16) num_cores = 16;
-    strip_pool_init(&strip_pool, num_cores);
+    int num_cores = strip_pool_cpu_count();
+    strip_pool_init(&strip_pool, num_cores, g_flags.main_assists, g_flags.pin_threads);
 
     // 9. Scene - load models and place objects
     scene_init(&scene);
@@ -170,6 +224,7 @@ int main(int argc, char *argv[]) {
 
     console_print(&console, "Software Renderer started", COLOR_RGB(100, 255, 100));
     console_print(&console, "Type 'help' for commands", COLOR_RGB(200, 200, 200));
+    console_printf(&console, COLOR_RGB(200, 200, 200), "Raster kernel: %s", raster_simd_name());
 
     // --- Main Loop ---
     bool running = true;
@@ -178,6 +233,14 @@ int main(int argc, char *argv[]) {
     float fps_accum = 0.0f;
     int fps_frame_count = 0;
 
+    // Pipelined mode: the workers rasterize one frame while this thread
+    // simulates and generates the next, so what is shown lags input by
+    // one extra frame
+    int  arena_index    = 0;
+    bool render_pending = false;
+    int  pending_chunks = 0;
+    int  pending_culled = 0;
+
     while (running) {
         // --- TIMING ---
         Uint64 now = SDL_GetPerformanceCounter();
@@ -186,6 +249,9 @@ int main(int argc, char *argv[]) {
         // Clamp dt to avoid spiral of death
         if (dt > 0.1f) dt = 0.1f;
 
+        timing_begin_frame(&timings);
+        double mark = timing_now();
+
         fps_accum += dt;
         fps_frame_count++;
         if (fps_accum >= 0.5f) {
@@ -216,6 +282,16 @@ int main(int argc, char *argv[]) {
             break;
         }
 
+        mark = timing_mark(&timings, TIMING_INPUT, mark);
+
+        // Console commands flip flags the workers read, so let an
+        // in-flight frame finish before running any
+        if (console.open && render_pending) {
+            finish_pending_frame(fps, pending_chunks, pending_culled);
+            render_pending = false;
+            mark = timing_now();
+        }
+
         // Route input
         if (console.open) {
             console_handle_input(&console, &input_state);
@@ -242,6 +318,8 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        mark = timing_mark(&timings, TIMING_INPUT, mark);
+
         // Sync flags to camera
         camera.fly_mode     = g_flags.fly_mode;
         camera.third_person = g_flags.third_person;
@@ -255,58 +333,102 @@ int main(int argc, char *argv[]) {
         physics_update(&physics_world, &scene, dt);
         physics_cleanup(&physics_world, &scene);
         scene_update(&scene, dt);
+        mark = timing_mark(&timings, TIMING_PHYSICS, mark);
+
+        // Restart the pool when its shape changed; no frame is in flight
+        // here unless pipelining, so wait for that one first
+        int lanes = g_flags.render_threads > 0 ? g_flags.render_threads : num_cores;
+        if (lanes != strip_pool.lanes_requested ||
+            g_flags.main_assists != strip_pool.assists_requested ||
+            g_flags.pin_threads != strip_pool.pinned) {
+            if (render_pending) {
+                finish_pending_frame(fps, pending_chunks, pending_culled);
+                render_pending = false;
+            }
+            strip_pool_destroy(&strip_pool);
+            strip_pool_init(&strip_pool, lanes, g_flags.main_assists, g_flags.pin_threads);
+            if (strip_pool.thread_count < lanes) {
+                console_printf(&console, COLOR_RGB(255, 100, 100),
+                               "threads: only %d of %d lanes started", strip_pool.thread_count, lanes);
+            }
+            mark = timing_now();
+        }
 
         // --- 3. CHUNK GENERATION ---
-        arena_reset(&frame_arena);
-        int max_chunks = 16384;
-        Chunk *chunks = arena_alloc(&frame_arena, max_chunks * sizeof(Chunk));
-        int chunk_count = 0;
-
-        if (chunks) {
+        // While a frame is in flight its chunks live in the other arena.
+        // The stream is sized for the worst case of the scene as it is
+        // now, and whatever the arena could not hold last time it grows
+        // to hold this time.
+        Arena *frame_arena = &frame_arenas[arena_index];
+        arena_reset_fit(frame_arena);
+        ChunkStream stream;
+        bool have_chunks = chunk_stream_init(&stream, frame_arena, scene_chunk_capacity(&scene));
+        int culled_objects = 0;
+
+        if (have_chunks) {
             float aspect = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
             Mat4 vp = camera_vp_matrix(&camera, aspect);
-            scene_generate_chunks(&scene, &vp, &frame_arena,
-                                  chunks, &chunk_count, max_chunks);
+            // While a frame is in flight the workers are busy with it, so
+            // generate on this thread
+            culled_objects = scene_generate_chunks(&scene, &vp, frame_arena,
+                                                   render_pending ? NULL : &strip_pool, &stream);
+            if (stream.dropped > 0) {
+                chunk_drops.total += stream.dropped;
+                chunk_drops.frames++;
+            }
+            mark = timing_mark(&timings, TIMING_CHUNKS, mark);
 
             // Sort front-to-back
-            chunks_sort_front_to_back(chunks, chunk_count);
-
-            // --- 4. STRIP DISTRIBUTION ---
-            strip_pool_distribute(&strip_pool, chunks, chunk_count);
+            chunks_sort_front_to_back(&stream);
+            mark = timing_mark(&timings, TIMING_SORT, mark);
         }
 
-        // --- 5. PARALLEL RENDER ---
-        display_clear(COLOR_RGB(30, 30, 50));
-        if (chunks) {
-            strip_pool_render(&strip_pool);
+        // Present the frame the workers were rasterizing meanwhile
+        if (render_pending) {
+            finish_pending_frame(fps, pending_chunks, pending_culled);
+            render_pending = false;
+            mark = timing_now();
         }
 
-        // --- 6. Z-BUFFER VISUALIZATION ---
-        if (g_flags.show_zbuffer) {
-            hud_render_zbuffer_viz();
+        // --- 4. STRIP DISTRIBUTION ---
+        if (have_chunks) {
+            strip_pool_distribute(&strip_pool, &stream, frame_arena);
+            mark = timing_mark(&timings, TIMING_DISTRIBUTE, mark);
         }
 
-        // --- 7. OVERLAY COMPOSITING ---
-        if (hud.flags_overlay.active) {
-            hud_render_flags(&glyph_cache, &g_flags);
-        }
-        if (hud.debug_overlay.active) {
-            hud_render_debug(&glyph_cache, fps, &camera, chunk_count);
-        }
-        if (hud.strip_overlay.active) {
-            hud_render_strips(&glyph_cache, &strip_pool);
+        // --- 5. PARALLEL RENDER ---
+        // Regions tile the screen, so the workers can clear it between them
+        uint32_t background = COLOR_RGB(30, 30, 50);
+        bool fused_clear = have_chunks && g_flags.fused_clear;
+        strip_pool_set_clear(&strip_pool, fused_clear, background);
+        if (!fused_clear) {
+            display_clear(background);
+            mark = timing_mark(&timings, TIMING_CLEAR, mark);
         }
-        if (console.open) {
-            console_render(&console, &glyph_cache);
+        if (have_chunks && g_flags.pipelined && !console.open) {
+            strip_pool_render_start(&strip_pool);
+            render_pending = true;
+            pending_chunks = stream.count;
+            pending_culled = culled_objects;
+            arena_index ^= 1;
+        } else {
+            if (have_chunks) {
+                strip_pool_render(&strip_pool);
+                timing_mark(&timings, TIMING_RENDER, mark);
+            }
+            finish_frame(fps, stream.count, culled_objects);
         }
+        timing_end_frame(&timings);
+    }
 
-        // --- 8. PRESENT ---
-        display_present();
+    if (render_pending) {
+        strip_pool_wait(&strip_pool);
     }
 
     // Cleanup
     strip_pool_destroy(&strip_pool);
-    arena_free(&frame_arena);
+    arena_free(&frame_arenas[0]);
+    arena_free(&frame_arenas[1]);
     scene_destroy(&scene);
     display_destroy();
     SDL_Quit();
@@ -3,6 +3,7 @@
 
 #include <math.h>
 #include <float.h>
+#include <stdbool.h>
 
 typedef struct { float x, y, z; } Vec3;
 typedef struct { float x, y, z, w; } Vec4;
@@ -247,6 +248,45 @@ static inline float rad_to_deg(float radians) {
     return radians * 180.0f / (float)M_PI;
 }
 
+// Planes as (normal, offset) with unit normals facing inward, so
+// dot(normal, p) + offset is the signed distance of p from each
+typedef struct {
+    Vec4 planes[6];
+} Frustum;
+
+// Gribb-Hartmann: each plane is the bottom row of the view-projection
+// matrix plus or minus one of the others, from -w <= x, y, z <= w
+static inline Frustum frustum_from_matrix(Mat4 m) {
+    Frustum f;
+    for (int i = 0; i < 3; i++) {
+        for (int side = 0; side < 2; side++) {
+            float sign = side == 0 ? 1.0f : -1.0f;
+            Vec4 p = {
+                m.m[3][0] + sign * m.m[i][0],
+                m.m[3][1] + sign * m.m[i][1],
+                m.m[3][2] + sign * m.m[i][2],
+                m.m[3][3] + sign * m.m[i][3],
+            };
+            float len = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+            if (len > 0.0f) {
+                p.x /= len; p.y /= len; p.z /= len; p.w /= len;
+            }
+            f.planes[i * 2 + side] = p;
+        }
+    }
+    return f;
+}
+
+// True when the sphere lies entirely outside one of the planes; spheres
+// that straddle a corner outside the frustum are kept
+static inline bool frustum_culls_sphere(const Frustum *f, Vec3 center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        const Vec4 *p = &f->planes[i];
+        if (p->x * center.x + p->y * center.y + p->z * center.z + p->w < -radius) return true;
+    }
+    return false;
+}
+
 static inline int mini(int a, int b) { return a < b ? a : b; }
 static inline int maxi(int a, int b) { return a > b ? a : b; }
 static inline float minf(float a, float b) { return a < b ? a : b; }
@@ -2,9 +2,119 @@
 #include "display.h"
 #include "flags.h"
 #include <math.h>
+#include <stdlib.h>
 
-static inline float edge_func(ScreenVertex v0, ScreenVertex v1, float px, float py) {
-    return (px - v0.x) * (v1.y - v0.y) - (py - v0.y) * (v1.x - v0.x);
+// Edge equations are evaluated on vertices snapped to a 1/16 pixel grid so
+// coverage is decided with exact integer math. Triangles sharing an edge see
+// identical edge values of opposite sign, and the top-left rule decides which
+// of them owns the pixels whose centers lie exactly on that edge.
+#define SUBPIXEL_BITS 4
+#define SUBPIXEL_ONE  (1 << SUBPIXEL_BITS)
+#define SUBPIXEL_HALF (SUBPIXEL_ONE / 2)
+
+// Only near-plane clipping happens upstream, so vertices can land far
+// off-screen. Beyond this distance the 64-bit edge products could overflow.
+#define RASTER_GUARD_BAND 4194304.0f
+
+#define FOG_START 0.95f
+#define FOG_COLOR COLOR_RGB(30, 30, 50)
+
+static inline int64_t min3_i64(int64_t a, int64_t b, int64_t c) {
+    int64_t m = a < b ? a : b;
+    return m < c ? m : c;
+}
+
+static inline int64_t max3_i64(int64_t a, int64_t b, int64_t c) {
+    int64_t m = a > b ? a : b;
+    return m > c ? m : c;
+}
+
+static inline Plane raster_plane(const RasterSetup *s, float a0, float a1, float a2) {
+    return (Plane){
+        a0 * s->bary[0].c  + a1 * s->bary[1].c  + a2 * s->bary[2].c,
+        a0 * s->bary[0].dx + a1 * s->bary[1].dx + a2 * s->bary[2].dx,
+        a0 * s->bary[0].dy + a1 * s->bary[1].dy + a2 * s->bary[2].dy,
+    };
+}
+
+static bool raster_setup_edges(const ScreenVertex v[3], RasterSetup *s) {
+    int64_t fx[3], fy[3];
+    for (int i = 0; i < 3; i++) {
+        if (!(fabsf(v[i].x) < RASTER_GUARD_BAND && fabsf(v[i].y) < RASTER_GUARD_BAND)) {
+            return false;
+        }
+        fx[i] = llrintf(v[i].x * SUBPIXEL_ONE);
+        fy[i] = llrintf(v[i].y * SUBPIXEL_ONE);
+    }
+
+    int64_t area = (fx[2] - fx[0]) * (fy[1] - fy[0]) - (fy[2] - fy[0]) * (fx[1] - fx[0]);
+    if (area == 0) return false;
+    int64_t sign = area > 0 ? 1 : -1;
+    area *= sign;
+
+    // Pixels whose centers fall inside the snapped bounding box
+    s->x_min = (int)((min3_i64(fx[0], fx[1], fx[2]) - SUBPIXEL_HALF + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+    s->x_max = (int)((max3_i64(fx[0], fx[1], fx[2]) - SUBPIXEL_HALF) >> SUBPIXEL_BITS) + 1;
+    s->y_min = (int)((min3_i64(fy[0], fy[1], fy[2]) - SUBPIXEL_HALF + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+    s->y_max = (int)((max3_i64(fy[0], fy[1], fy[2]) - SUBPIXEL_HALF) >> SUBPIXEL_BITS) + 1;
+
+    s->origin_x = (int)(fx[0] >> SUBPIXEL_BITS);
+    s->origin_y = (int)(fy[0] >> SUBPIXEL_BITS);
+    int64_t px = ((int64_t)s->origin_x << SUBPIXEL_BITS) + SUBPIXEL_HALF;
+    int64_t py = ((int64_t)s->origin_y << SUBPIXEL_BITS) + SUBPIXEL_HALF;
+
+    // Edge i lies opposite vertex i and is oriented so the interior is positive
+    double inv_area = 1.0 / (double)area;
+    for (int i = 0; i < 3; i++) {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        int64_t ex = (fy[b] - fy[a]) * sign;
+        int64_t ey = (fx[a] - fx[b]) * sign;
+        int64_t e  = (px - fx[a]) * ex + (py - fy[a]) * ey;
+
+        // Top-left rule: pixels exactly on a right or bottom edge belong to
+        // the neighboring triangle, so bias those edges to exclude zero
+        bool top_left = ex > 0 || (ex == 0 && ey > 0);
+        s->edge_c[i]  = top_left ? e : e - 1;
+        s->edge_dx[i] = ex * SUBPIXEL_ONE;
+        s->edge_dy[i] = ey * SUBPIXEL_ONE;
+
+        s->bary[i].c  = (float)((double)e * inv_area);
+        s->bary[i].dx = (float)((double)s->edge_dx[i] * inv_area);
+        s->bary[i].dy = (float)((double)s->edge_dy[i] * inv_area);
+    }
+
+    s->z     = raster_plane(s, v[0].z, v[1].z, v[2].z);
+    s->z_min = minf(v[0].z, minf(v[1].z, v[2].z));
+    return true;
+}
+
+void raster_setup(const Chunk *chunk, RasterSetup *s) {
+    const ScreenVertex *v = chunk->verts;
+    if (!raster_setup_edges(v, s)) {
+        s->x_min = s->x_max = 0;
+        s->y_min = s->y_max = 0;
+        return;
+    }
+
+    // Perspective-correct UVs: interpolate u/w, v/w and 1/w linearly in
+    // screen space, then divide per pixel
+    if (chunk->type == CHUNK_TEXTURED) {
+        const Vec2 *uv = chunk->textured.uvs;
+        s->iw = raster_plane(s, v[0].inv_w, v[1].inv_w, v[2].inv_w);
+        s->uw = raster_plane(s, uv[0].x * v[0].inv_w, uv[1].x * v[1].inv_w, uv[2].x * v[2].inv_w);
+        s->vw = raster_plane(s, uv[0].y * v[0].inv_w, uv[1].y * v[1].inv_w, uv[2].y * v[2].inv_w);
+    }
+}
+
+// Attributes are always evaluated as row + dx * offset so every pixel's value
+// depends only on its position, not on the order pixels were visited in
+static inline float plane_row(Plane p, int dy) {
+    return p.c + p.dy * (float)dy;
+}
+
+static inline float plane_at(float row, Plane p, int dx) {
+    return row + p.dx * (float)dx;
 }
 
 static uint32_t color_lerp(uint32_t c1, uint32_t c2, float t) {
@@ -14,121 +124,989 @@ static uint32_t color_lerp(uint32_t c1, uint32_t c2, float t) {
     return COLOR_RGB(r, g, b);
 }
 
-void raster_colored_triangle(const Chunk * restrict chunk,
-                              int x_min_clip, int x_max_clip) {
-    ScreenVertex v0 = chunk->verts[0];
-    ScreenVertex v1 = chunk->verts[1];
-    ScreenVertex v2 = chunk->verts[2];
-    uint32_t color = chunk->colored.color;
+static inline uint32_t texture_sample(const Texture *tex, float u, float v) {
+    u = u - floorf(u);
+    v = v - floorf(v);
 
-    int bb_x_min = maxi((int)floorf(minf(v0.x, minf(v1.x, v2.x))), x_min_clip);
-    int bb_x_max = mini((int)ceilf(maxf(v0.x, maxf(v1.x, v2.x))),  x_max_clip);
-    int bb_y_min = maxi((int)floorf(minf(v0.y, minf(v1.y, v2.y))), 0);
-    int bb_y_max = mini((int)ceilf(maxf(v0.y, maxf(v1.y, v2.y))),  WINDOW_HEIGHT);
+    int tex_x = (int)(u * tex->width) % tex->width;
+    int tex_y = (int)(v * tex->height) % tex->height;
+    if (tex_x < 0) tex_x += tex->width;
+    if (tex_y < 0) tex_y += tex->height;
 
-    float area = edge_func(v0, v1, v2.x, v2.y);
-    if (fabsf(area) < 1e-6f) return;
-    float inv_area = 1.0f / area;
+    return tex->pixels[texture_offset(tex, tex_x, tex_y)];
+}
 
-    for (int y = bb_y_min; y < bb_y_max; y++) {
-        for (int x = bb_x_min; x < bb_x_max; x++) {
-            float px = x + 0.5f;
-            float py = y + 0.5f;
+// Power-of-two textures wrap with masks on 16.16 fixed-point texel
+// coordinates. The conversion truncates toward zero, which differs from
+// floorf() only within 1/65536 of a texel edge.
+static inline uint32_t texture_sample_pow2(const Texture *tex, float u, float v) {
+    uint32_t fu = (uint32_t)(int32_t)(u * (float)(tex->width  << 16));
+    uint32_t fv = (uint32_t)(int32_t)(v * (float)(tex->height << 16));
+    int tex_x = (int)(fu >> 16) & (tex->width  - 1);
+    int tex_y = (int)(fv >> 16) & (tex->height - 1);
+    return tex->pixels[texture_offset(tex, tex_x, tex_y)];
+}
 
-            float w0 = edge_func(v1, v2, px, py) * inv_area;
-            float w1 = edge_func(v2, v0, px, py) * inv_area;
-            float w2 = edge_func(v0, v1, px, py) * inv_area;
+// Fixed-point coordinates need 16 integer bits. Interpolated UVs stay
+// within the vertex UVs, and half the range leaves room for rounding.
+#define TEXTURE_POW2_RANGE 16384.0f
 
-            if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+static bool texture_use_pow2(const RasterPipeline *p, const Texture *tex, const Vec2 uv[3]) {
+    if (!tex->pow2 || !p->pow2_textures) return false;
+    float size = (float)maxi(tex->width, tex->height);
+    for (int i = 0; i < 3; i++) {
+        if (!(fabsf(uv[i].x) * size < TEXTURE_POW2_RANGE &&
+              fabsf(uv[i].y) * size < TEXTURE_POW2_RANGE)) return false;
+    }
+    return true;
+}
 
-            float depth = w0 * v0.z + w1 * v1.z + w2 * v2.z;
+// Shading kernels are written once as always-inlined bodies taking fog,
+// the depth test and the addressing mode as constants, and instantiated
+// for every combination below, so no flag is tested per pixel. Variants
+// are listed as (suffix, fog, depth_equal, pow2).
+#define RASTER_INLINE static inline __attribute__((always_inline))
 
-            int idx = y * WINDOW_WIDTH + x;
-            if (depth < zbuf[idx]) {
-                uint32_t final_color = color;
-                if (g_flags.fog_enabled) {
-                    float fog_factor = clampf((depth - 0.95f) / (1.0f - 0.95f), 0.0f, 1.0f);
-                    final_color = color_lerp(color, COLOR_RGB(30, 30, 50), fog_factor);
+#define COLORED_VARIANTS(X) \
+    X(_f0e0, false, false, false) X(_f0e1, false, true, false) \
+    X(_f1e0, true,  false, false) X(_f1e1, true,  true, false)
+
+#define TEXTURED_VARIANTS(X) \
+    X(_f0e0p0, false, false, false) X(_f0e0p1, false, false, true) \
+    X(_f0e1p0, false, true,  false) X(_f0e1p1, false, true,  true) \
+    X(_f1e0p0, true,  false, false) X(_f1e0p1, true,  false, true) \
+    X(_f1e1p0, true,  true,  false) X(_f1e1p1, true,  true,  true)
+
+#define RESOLVE_VARIANTS(X) \
+    X(_f0p0, false, false, false) X(_f0p1, false, false, true) \
+    X(_f1p0, true,  false, false) X(_f1p1, true,  false, true)
+
+// Coverage is resolved into horizontal runs of covered pixels, which are then
+// handed to a span function doing depth test and shading for the run
+typedef void (*SpanFunc)(const void *ctx, int y, int x_start, int x_end);
+
+typedef struct {
+    Plane pz;
+    int   origin_x, origin_y;
+} DepthSpan;
+
+typedef struct {
+    Plane    pz;
+    uint32_t color;
+    int      origin_x, origin_y;
+} ColoredSpan;
+
+typedef struct {
+    const Texture *tex;
+    Plane pz, piw, puw, pvw;
+    int   origin_x, origin_y;
+} TexturedSpan;
+
+typedef struct {
+    Plane    pz, pb1, pb2;
+    uint32_t id;
+    int      origin_x, origin_y;
+} VisSpan;
+
+static void depth_span_scalar(const void *ctx, int y, int x_start, int x_end) {
+    const DepthSpan *sp = ctx;
+    float z_row = plane_row(sp->pz, y - sp->origin_y);
+    int row = y * WINDOW_WIDTH;
+
+    for (int x = x_start; x < x_end; x++) {
+        float depth = plane_at(z_row, sp->pz, x - sp->origin_x);
+        int idx = row + x;
+        if (depth < zbuf[idx]) zbuf[idx] = depth;
+    }
+}
+
+static void vis_span_scalar(const void *ctx, int y, int x_start, int x_end) {
+    const VisSpan *sp = ctx;
+    int dy = y - sp->origin_y;
+    float z_row  = plane_row(sp->pz, dy);
+    float b1_row = plane_row(sp->pb1, dy);
+    float b2_row = plane_row(sp->pb2, dy);
+    int row = y * WINDOW_WIDTH;
+
+    for (int x = x_start; x < x_end; x++) {
+        int dx = x - sp->origin_x;
+        float depth = plane_at(z_row, sp->pz, dx);
+        int idx = row + x;
+        if (depth >= zbuf[idx]) continue;
+
+        zbuf[idx] = depth;
+        vis_buffer[idx] = (VisRecord){
+            sp->id,
+            plane_at(b1_row, sp->pb1, dx),
+            plane_at(b2_row, sp->pb2, dx),
+        };
+    }
+}
+
+RASTER_INLINE void colored_span_body(const ColoredSpan *sp, int y, int x_start, int x_end,
+                                     bool fog, bool depth_equal) {
+    float z_row = plane_row(sp->pz, y - sp->origin_y);
+    int row = y * WINDOW_WIDTH;
+
+    for (int x = x_start; x < x_end; x++) {
+        float depth = plane_at(z_row, sp->pz, x - sp->origin_x);
+        int idx = row + x;
+        if (depth_equal ? depth == zbuf[idx] : depth < zbuf[idx]) {
+            uint32_t final_color = sp->color;
+            if (fog) {
+                float fog_factor = clampf((depth - FOG_START) / (1.0f - FOG_START), 0.0f, 1.0f);
+                final_color = color_lerp(sp->color, FOG_COLOR, fog_factor);
+            }
+            zbuf[idx] = depth;
+            display_buffer[idx] = final_color;
+        }
+    }
+}
+
+#define X(name, fog, depth_equal, pow2) \
+    static void colored_span_scalar##name(const void *ctx, int y, int x_start, int x_end) { \
+        colored_span_body(ctx, y, x_start, x_end, fog, depth_equal); \
+    }
+COLORED_VARIANTS(X)
+#undef X
+
+RASTER_INLINE void textured_span_body(const TexturedSpan *sp, int y, int x_start, int x_end,
+                                      bool fog, bool depth_equal, bool pow2) {
+    int dy = y - sp->origin_y;
+    float z_row  = plane_row(sp->pz, dy);
+    float iw_row = plane_row(sp->piw, dy);
+    float uw_row = plane_row(sp->puw, dy);
+    float vw_row = plane_row(sp->pvw, dy);
+    int row = y * WINDOW_WIDTH;
+
+    for (int x = x_start; x < x_end; x++) {
+        int dx = x - sp->origin_x;
+        float depth = plane_at(z_row, sp->pz, dx);
+        int idx = row + x;
+        if (depth_equal ? depth != zbuf[idx] : depth >= zbuf[idx]) continue;
+
+        float w_at_pixel = 1.0f / plane_at(iw_row, sp->piw, dx);
+        float u = plane_at(uw_row, sp->puw, dx) * w_at_pixel;
+        float v_coord = plane_at(vw_row, sp->pvw, dx) * w_at_pixel;
+
+        uint32_t texel = pow2 ? texture_sample_pow2(sp->tex, u, v_coord)
+                              : texture_sample(sp->tex, u, v_coord);
+
+        if (fog) {
+            float fog_factor = clampf((depth - FOG_START) / (1.0f - FOG_START), 0.0f, 1.0f);
+            texel = color_lerp(texel, FOG_COLOR, fog_factor);
+        }
+
+        zbuf[idx] = depth;
+        display_buffer[idx] = texel;
+    }
+}
+
+#define X(name, fog, depth_equal, pow2) \
+    static void textured_span_scalar##name(const void *ctx, int y, int x_start, int x_end) { \
+        textured_span_body(ctx, y, x_start, x_end, fog, depth_equal, pow2); \
+    }
+TEXTURED_VARIANTS(X)
+#undef X
+
+// Shades a run of pixels the visibility pass attributed to one chunk.
+// Attributes are interpolated from the vertices with the recorded
+// barycentrics rather than from span planes, so they can differ from the
+// forward path in the last bit.
+typedef void (*VisResolveFunc)(const Chunk *chunk, int idx, int count);
+
+RASTER_INLINE void vis_resolve_body(const Chunk *chunk, int idx, int count, bool fog,
+                                    bool pow2) {
+    const ScreenVertex *v = chunk->verts;
+    const Vec2 *uv = chunk->textured.uvs;
+    bool textured = chunk->type == CHUNK_TEXTURED;
+
+    for (int i = idx; i < idx + count; i++) {
+        uint32_t color = chunk->colored.color;
+        if (textured) {
+            const VisRecord *rec = &vis_buffer[i];
+            float w0 = (1.0f - rec->b1 - rec->b2) * v[0].inv_w;
+            float w1 = rec->b1 * v[1].inv_w;
+            float w2 = rec->b2 * v[2].inv_w;
+            float w_at_pixel = 1.0f / (w0 + w1 + w2);
+            float u       = (w0 * uv[0].x + w1 * uv[1].x + w2 * uv[2].x) * w_at_pixel;
+            float v_coord = (w0 * uv[0].y + w1 * uv[1].y + w2 * uv[2].y) * w_at_pixel;
+            color = pow2 ? texture_sample_pow2(chunk->textured.texture, u, v_coord)
+                         : texture_sample(chunk->textured.texture, u, v_coord);
+        }
+
+        if (fog) {
+            float fog_factor = clampf((zbuf[i] - FOG_START) / (1.0f - FOG_START), 0.0f, 1.0f);
+            color = color_lerp(color, FOG_COLOR, fog_factor);
+        }
+        display_buffer[i] = color;
+    }
+}
+
+#define X(name, fog, depth_equal, pow2) \
+    static void vis_resolve_scalar##name(const Chunk *chunk, int idx, int count) { \
+        vis_resolve_body(chunk, idx, count, fog, pow2); \
+    }
+RESOLVE_VARIANTS(X)
+#undef X
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// floorf() for SSE2, which lacks a rounding instruction. Magnitudes of 2^23
+// and above are already integral and would overflow the conversion.
+static inline __m128 floor_sse2(__m128 x) {
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), one));
+    __m128 ax  = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    __m128 big = _mm_cmpge_ps(ax, _mm_set1_ps(8388608.0f));
+    return _mm_or_ps(_mm_and_ps(big, x), _mm_andnot_ps(big, t));
+}
+
+static inline __m128i fog_sse2(__m128i texel, __m128 depth) {
+    __m128 t = _mm_div_ps(_mm_sub_ps(depth, _mm_set1_ps(FOG_START)),
+                          _mm_set1_ps(1.0f - FOG_START));
+    t = _mm_max_ps(_mm_min_ps(t, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+    __m128 it = _mm_sub_ps(_mm_set1_ps(1.0f), t);
+    __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i out = _mm_set1_epi32((int)0xFF000000);
+    for (int shift = 0; shift <= 16; shift += 8) {
+        __m128 c = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texel, shift), mask));
+        float fog_c = (float)((FOG_COLOR >> shift) & 0xFF);
+        __m128 r = _mm_add_ps(_mm_mul_ps(it, c), _mm_mul_ps(t, _mm_set1_ps(fog_c)));
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_cvttps_epi32(r), shift));
+    }
+    return out;
+}
+
+static void depth_span_sse2(const void *ctx, int y, int x_start, int x_end) {
+    const DepthSpan *sp = ctx;
+    __m128 pz_dx = _mm_set1_ps(sp->pz.dx);
+    __m128 z_row = _mm_set1_ps(plane_row(sp->pz, y - sp->origin_y));
+    __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    int row = y * WINDOW_WIDTH;
+
+    int x = x_start;
+    for (; x + 4 <= x_end; x += 4) {
+        __m128 fdx   = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x - sp->origin_x), lane));
+        __m128 depth = _mm_add_ps(z_row, _mm_mul_ps(pz_dx, fdx));
+        __m128 old_z = _mm_loadu_ps(&zbuf[row + x]);
+        __m128 pass  = _mm_cmplt_ps(depth, old_z);
+        _mm_storeu_ps(&zbuf[row + x], _mm_or_ps(_mm_and_ps(pass, depth), _mm_andnot_ps(pass, old_z)));
+    }
+
+    if (x < x_end) {
+        depth_span_scalar(sp, y, x, x_end);
+    }
+}
+
+RASTER_INLINE void textured_span_sse2_body(const TexturedSpan *sp, int y, int x_start, int x_end,
+                                           bool fog, bool depth_equal, bool pow2) {
+    const Texture *tex = sp->tex;
+    int dy  = y - sp->origin_y;
+    int row = y * WINDOW_WIDTH;
+    __m128 pz_dx  = _mm_set1_ps(sp->pz.dx);
+    __m128 piw_dx = _mm_set1_ps(sp->piw.dx);
+    __m128 puw_dx = _mm_set1_ps(sp->puw.dx);
+    __m128 pvw_dx = _mm_set1_ps(sp->pvw.dx);
+    __m128 z_row  = _mm_set1_ps(plane_row(sp->pz, dy));
+    __m128 iw_row = _mm_set1_ps(plane_row(sp->piw, dy));
+    __m128 uw_row = _mm_set1_ps(plane_row(sp->puw, dy));
+    __m128 vw_row = _mm_set1_ps(plane_row(sp->pvw, dy));
+    __m128 tex_w  = _mm_set1_ps((float)tex->width);
+    __m128 tex_h  = _mm_set1_ps((float)tex->height);
+    __m128i tex_wi = _mm_set1_epi32(tex->width);
+    __m128i tex_hi = _mm_set1_epi32(tex->height);
+    __m128 fix_w   = _mm_set1_ps((float)(tex->width  << 16));
+    __m128 fix_h   = _mm_set1_ps((float)(tex->height << 16));
+    __m128i mask_w = _mm_set1_epi32(tex->width  - 1);
+    __m128i mask_h = _mm_set1_epi32(tex->height - 1);
+    __m128i lane   = _mm_setr_epi32(0, 1, 2, 3);
+
+    int x = x_start;
+    for (; x + 4 <= x_end; x += 4) {
+        int idx = row + x;
+        __m128 fdx   = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x - sp->origin_x), lane));
+        __m128 depth = _mm_add_ps(z_row, _mm_mul_ps(pz_dx, fdx));
+        __m128 old_z = _mm_loadu_ps(&zbuf[idx]);
+        __m128 pass  = depth_equal ? _mm_cmpeq_ps(depth, old_z) : _mm_cmplt_ps(depth, old_z);
+        int pass_bits = _mm_movemask_ps(pass);
+        if (!pass_bits) continue;
+
+        __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(iw_row, _mm_mul_ps(piw_dx, fdx)));
+        __m128 u = _mm_mul_ps(_mm_add_ps(uw_row, _mm_mul_ps(puw_dx, fdx)), w);
+        __m128 v = _mm_mul_ps(_mm_add_ps(vw_row, _mm_mul_ps(pvw_dx, fdx)), w);
+
+        __m128i tx, ty;
+        if (pow2) {
+            tx = _mm_and_si128(_mm_srli_epi32(_mm_cvttps_epi32(_mm_mul_ps(u, fix_w)), 16), mask_w);
+            ty = _mm_and_si128(_mm_srli_epi32(_mm_cvttps_epi32(_mm_mul_ps(v, fix_h)), 16), mask_h);
+        } else {
+            u = _mm_sub_ps(u, floor_sse2(u));
+            v = _mm_sub_ps(v, floor_sse2(v));
+
+            // u, v in [0, 1] so the product can only reach the size itself
+            tx = _mm_cvttps_epi32(_mm_mul_ps(u, tex_w));
+            ty = _mm_cvttps_epi32(_mm_mul_ps(v, tex_h));
+            tx = _mm_sub_epi32(tx, _mm_andnot_si128(_mm_cmplt_epi32(tx, tex_wi), tex_wi));
+            ty = _mm_sub_epi32(ty, _mm_andnot_si128(_mm_cmplt_epi32(ty, tex_hi), tex_hi));
+        }
+
+        // No gather in SSE2: fetch the passing lanes one at a time
+        int txs[4], tys[4];
+        uint32_t texels[4] = {0};
+        _mm_storeu_si128((__m128i *)txs, tx);
+        _mm_storeu_si128((__m128i *)tys, ty);
+        for (int i = 0; i < 4; i++) {
+            if (pass_bits & (1 << i)) {
+                texels[i] = tex->pixels[texture_offset(tex, txs[i], tys[i])];
+            }
+        }
+        __m128i color = _mm_loadu_si128((const __m128i *)texels);
+        if (fog) color = fog_sse2(color, depth);
+
+        // All four lanes lie inside this strip, so a read-modify-write
+        // blend acts as a masked store
+        __m128i pass_i  = _mm_castps_si128(pass);
+        __m128i old_c   = _mm_loadu_si128((const __m128i *)&display_buffer[idx]);
+        _mm_storeu_ps(&zbuf[idx], _mm_or_ps(_mm_and_ps(pass, depth), _mm_andnot_ps(pass, old_z)));
+        _mm_storeu_si128((__m128i *)&display_buffer[idx],
+                         _mm_or_si128(_mm_and_si128(pass_i, color), _mm_andnot_si128(pass_i, old_c)));
+    }
+
+    if (x < x_end) {
+        textured_span_body(sp, y, x, x_end, fog, depth_equal, pow2);
+    }
+}
+
+#define X(name, fog, depth_equal, pow2) \
+    static void textured_span_sse2##name(const void *ctx, int y, int x_start, int x_end) { \
+        textured_span_sse2_body(ctx, y, x_start, x_end, fog, depth_equal, pow2); \
+    }
+TEXTURED_VARIANTS(X)
+#undef X
+
+__attribute__((target("avx2")))
+static inline __m256i fog_avx2(__m256i texel, __m256 depth) {
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(depth, _mm256_set1_ps(FOG_START)),
+                             _mm256_set1_ps(1.0f - FOG_START));
+    t = _mm256_max_ps(_mm256_min_ps(t, _mm256_set1_ps(1.0f)), _mm256_setzero_ps());
+    __m256 it = _mm256_sub_ps(_mm256_set1_ps(1.0f), t);
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i out = _mm256_set1_epi32((int)0xFF000000);
+    for (int shift = 0; shift <= 16; shift += 8) {
+        __m256 c = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel, shift), mask));
+        float fog_c = (float)((FOG_COLOR >> shift) & 0xFF);
+        __m256 r = _mm256_add_ps(_mm256_mul_ps(it, c), _mm256_mul_ps(t, _mm256_set1_ps(fog_c)));
+        out = _mm256_or_si256(out, _mm256_slli_epi32(_mm256_cvttps_epi32(r), shift));
+    }
+    return out;
+}
+
+// Fetches the texels at (u, v) for the lanes set in mask, others read 0
+__attribute__((target("avx2")))
+RASTER_INLINE __m256i texture_sample_avx2(const Texture *tex, __m256 u, __m256 v, __m256i mask,
+                                          bool pow2) {
+    __m256i tx, ty;
+    if (pow2) {
+        __m256 fix_w = _mm256_set1_ps((float)(tex->width  << 16));
+        __m256 fix_h = _mm256_set1_ps((float)(tex->height << 16));
+        tx = _mm256_and_si256(_mm256_srli_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(u, fix_w)), 16),
+                              _mm256_set1_epi32(tex->width - 1));
+        ty = _mm256_and_si256(_mm256_srli_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(v, fix_h)), 16),
+                              _mm256_set1_epi32(tex->height - 1));
+    } else {
+        __m256i tex_wi = _mm256_set1_epi32(tex->width);
+        __m256i tex_hi = _mm256_set1_epi32(tex->height);
+        u = _mm256_sub_ps(u, _mm256_floor_ps(u));
+        v = _mm256_sub_ps(v, _mm256_floor_ps(v));
+
+        tx = _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps((float)tex->width)));
+        ty = _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps((float)tex->height)));
+        tx = _mm256_sub_epi32(tx, _mm256_andnot_si256(_mm256_cmpgt_epi32(tex_wi, tx), tex_wi));
+        ty = _mm256_sub_epi32(ty, _mm256_andnot_si256(_mm256_cmpgt_epi32(tex_hi, ty), tex_hi));
+    }
+
+    // Blocked layout, see texture_offset()
+    __m256i inner_mask = _mm256_set1_epi32(TEXTURE_BLOCK - 1);
+    __m256i block  = _mm256_add_epi32(
+        _mm256_mullo_epi32(_mm256_srli_epi32(ty, TEXTURE_BLOCK_BITS),
+                           _mm256_set1_epi32(texture_blocks_x(tex))),
+        _mm256_srli_epi32(tx, TEXTURE_BLOCK_BITS));
+    __m256i inner  = _mm256_or_si256(
+        _mm256_slli_epi32(_mm256_and_si256(ty, inner_mask), TEXTURE_BLOCK_BITS),
+        _mm256_and_si256(tx, inner_mask));
+    __m256i offset = _mm256_or_si256(_mm256_slli_epi32(block, 2 * TEXTURE_BLOCK_BITS), inner);
+    return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)tex->pixels,
+                                       offset, mask, 4);
+}
+
+__attribute__((target("avx2")))
+static void depth_span_avx2(const void *ctx, int y, int x_start, int x_end) {
+    const DepthSpan *sp = ctx;
+    __m256 pz_dx = _mm256_set1_ps(sp->pz.dx);
+    __m256 z_row = _mm256_set1_ps(plane_row(sp->pz, y - sp->origin_y));
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int row = y * WINDOW_WIDTH;
+
+    for (int x = x_start; x < x_end; x += 8) {
+        __m256i in_span = _mm256_cmpgt_epi32(_mm256_set1_epi32(x_end - x), lane);
+        __m256 fdx   = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x - sp->origin_x), lane));
+        __m256 depth = _mm256_add_ps(z_row, _mm256_mul_ps(pz_dx, fdx));
+        __m256 old_z = _mm256_maskload_ps(&zbuf[row + x], in_span);
+        __m256 pass  = _mm256_and_ps(_mm256_cmp_ps(depth, old_z, _CMP_LT_OQ),
+                                     _mm256_castsi256_ps(in_span));
+        _mm256_maskstore_ps(&zbuf[row + x], _mm256_castps_si256(pass), depth);
+    }
+}
+
+__attribute__((target("avx2")))
+static void vis_span_avx2(const void *ctx, int y, int x_start, int x_end) {
+    const VisSpan *sp = ctx;
+    int dy  = y - sp->origin_y;
+    int row = y * WINDOW_WIDTH;
+    __m256 pz_dx  = _mm256_set1_ps(sp->pz.dx);
+    __m256 pb1_dx = _mm256_set1_ps(sp->pb1.dx);
+    __m256 pb2_dx = _mm256_set1_ps(sp->pb2.dx);
+    __m256 z_row  = _mm256_set1_ps(plane_row(sp->pz, dy));
+    __m256 b1_row = _mm256_set1_ps(plane_row(sp->pb1, dy));
+    __m256 b2_row = _mm256_set1_ps(plane_row(sp->pb2, dy));
+    __m256i lane  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int x = x_start; x < x_end; x += 8) {
+        int idx = row + x;
+        __m256i in_span = _mm256_cmpgt_epi32(_mm256_set1_epi32(x_end - x), lane);
+        __m256 fdx   = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x - sp->origin_x), lane));
+        __m256 depth = _mm256_add_ps(z_row, _mm256_mul_ps(pz_dx, fdx));
+        __m256 old_z = _mm256_maskload_ps(&zbuf[idx], in_span);
+        __m256 pass  = _mm256_and_ps(_mm256_cmp_ps(depth, old_z, _CMP_LT_OQ),
+                                     _mm256_castsi256_ps(in_span));
+        int pass_bits = _mm256_movemask_ps(pass);
+        if (!pass_bits) continue;
+        _mm256_maskstore_ps(&zbuf[idx], _mm256_castps_si256(pass), depth);
+
+        // Records are interleaved, so they are written lane by lane
+        float b1[8], b2[8];
+        _mm256_storeu_ps(b1, _mm256_add_ps(b1_row, _mm256_mul_ps(pb1_dx, fdx)));
+        _mm256_storeu_ps(b2, _mm256_add_ps(b2_row, _mm256_mul_ps(pb2_dx, fdx)));
+        for (int i = 0; i < 8; i++) {
+            if (pass_bits & (1 << i)) {
+                vis_buffer[idx + i] = (VisRecord){ sp->id, b1[i], b2[i] };
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+RASTER_INLINE void textured_span_avx2_body(const TexturedSpan *sp, int y, int x_start, int x_end,
+                                           bool fog, bool depth_equal, bool pow2) {
+    const Texture *tex = sp->tex;
+    int dy  = y - sp->origin_y;
+    int row = y * WINDOW_WIDTH;
+    __m256 pz_dx  = _mm256_set1_ps(sp->pz.dx);
+    __m256 piw_dx = _mm256_set1_ps(sp->piw.dx);
+    __m256 puw_dx = _mm256_set1_ps(sp->puw.dx);
+    __m256 pvw_dx = _mm256_set1_ps(sp->pvw.dx);
+    __m256 z_row  = _mm256_set1_ps(plane_row(sp->pz, dy));
+    __m256 iw_row = _mm256_set1_ps(plane_row(sp->piw, dy));
+    __m256 uw_row = _mm256_set1_ps(plane_row(sp->puw, dy));
+    __m256 vw_row = _mm256_set1_ps(plane_row(sp->pvw, dy));
+    __m256i lane  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int x = x_start; x < x_end; x += 8) {
+        int idx = row + x;
+        // Lanes past the end of the span are masked off for loads and stores
+        __m256i in_span = _mm256_cmpgt_epi32(_mm256_set1_epi32(x_end - x), lane);
+        __m256 fdx   = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x - sp->origin_x), lane));
+        __m256 depth = _mm256_add_ps(z_row, _mm256_mul_ps(pz_dx, fdx));
+        __m256 old_z = _mm256_maskload_ps(&zbuf[idx], in_span);
+        __m256 test  = depth_equal ? _mm256_cmp_ps(depth, old_z, _CMP_EQ_OQ)
+                                   : _mm256_cmp_ps(depth, old_z, _CMP_LT_OQ);
+        __m256 pass  = _mm256_and_ps(test, _mm256_castsi256_ps(in_span));
+        if (_mm256_testz_ps(pass, pass)) continue;
+
+        __m256 w = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(iw_row, _mm256_mul_ps(piw_dx, fdx)));
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(uw_row, _mm256_mul_ps(puw_dx, fdx)), w);
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(vw_row, _mm256_mul_ps(pvw_dx, fdx)), w);
+
+        __m256i pass_i = _mm256_castps_si256(pass);
+        __m256i color  = texture_sample_avx2(tex, u, v, pass_i, pow2);
+        if (fog) color = fog_avx2(color, depth);
+
+        _mm256_maskstore_ps(&zbuf[idx], pass_i, depth);
+        _mm256_maskstore_epi32((int *)&display_buffer[idx], pass_i, color);
+    }
+}
+
+#define X(name, fog, depth_equal, pow2) \
+    __attribute__((target("avx2"))) \
+    static void textured_span_avx2##name(const void *ctx, int y, int x_start, int x_end) { \
+        textured_span_avx2_body(ctx, y, x_start, x_end, fog, depth_equal, pow2); \
+    }
+TEXTURED_VARIANTS(X)
+#undef X
+
+__attribute__((target("avx2")))
+RASTER_INLINE void vis_resolve_avx2_body(const Chunk *chunk, int idx, int count, bool fog,
+                                         bool pow2) {
+    const ScreenVertex *v = chunk->verts;
+    const Vec2 *uv = chunk->textured.uvs;
+    bool textured = chunk->type == CHUNK_TEXTURED;
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    // Barycentrics are strided by the record size, in floats
+    __m256i rec_stride = _mm256_mullo_epi32(lane, _mm256_set1_epi32(sizeof(VisRecord) / sizeof(float)));
+
+    for (int i = 0; i < count; i += 8) {
+        int p = idx + i;
+        __m256i in_span = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - i), lane);
+        __m256i color;
+        if (textured) {
+            __m256 mask = _mm256_castsi256_ps(in_span);
+            __m256 b1 = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), &vis_buffer[p].b1,
+                                                 rec_stride, mask, 4);
+            __m256 b2 = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), &vis_buffer[p].b2,
+                                                 rec_stride, mask, 4);
+            __m256 b0 = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), b1), b2);
+            __m256 w0 = _mm256_mul_ps(b0, _mm256_set1_ps(v[0].inv_w));
+            __m256 w1 = _mm256_mul_ps(b1, _mm256_set1_ps(v[1].inv_w));
+            __m256 w2 = _mm256_mul_ps(b2, _mm256_set1_ps(v[2].inv_w));
+            __m256 w  = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(_mm256_add_ps(w0, w1), w2));
+            __m256 u  = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w0, _mm256_set1_ps(uv[0].x)),
+                                                    _mm256_mul_ps(w1, _mm256_set1_ps(uv[1].x))),
+                                      _mm256_mul_ps(w2, _mm256_set1_ps(uv[2].x)));
+            __m256 vv = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w0, _mm256_set1_ps(uv[0].y)),
+                                                    _mm256_mul_ps(w1, _mm256_set1_ps(uv[1].y))),
+                                      _mm256_mul_ps(w2, _mm256_set1_ps(uv[2].y)));
+            color = texture_sample_avx2(chunk->textured.texture, _mm256_mul_ps(u, w),
+                                        _mm256_mul_ps(vv, w), in_span, pow2);
+        } else {
+            color = _mm256_set1_epi32((int)chunk->colored.color);
+        }
+        if (fog) color = fog_avx2(color, _mm256_maskload_ps(&zbuf[p], in_span));
+
+        _mm256_maskstore_epi32((int *)&display_buffer[p], in_span, color);
+    }
+}
+
+#define X(name, fog, depth_equal, pow2) \
+    __attribute__((target("avx2"))) \
+    static void vis_resolve_avx2##name(const Chunk *chunk, int idx, int count) { \
+        vis_resolve_avx2_body(chunk, idx, count, fog, pow2); \
+    }
+RESOLVE_VARIANTS(X)
+#undef X
+#endif
+
+
+static const SpanFunc colored_span_scalars[2][2] = {
+#define X(name, fog, depth_equal, pow2) [fog][depth_equal] = colored_span_scalar##name,
+    COLORED_VARIANTS(X)
+#undef X
+};
+
+static const SpanFunc textured_span_scalars[2][2][2] = {
+#define X(name, fog, depth_equal, pow2) [fog][depth_equal][pow2] = textured_span_scalar##name,
+    TEXTURED_VARIANTS(X)
+#undef X
+};
+
+static const VisResolveFunc vis_resolve_scalars[2][2] = {
+#define X(name, fog, depth_equal, pow2) [fog][pow2] = vis_resolve_scalar##name,
+    RESOLVE_VARIANTS(X)
+#undef X
+};
+
+#if defined(__SSE2__)
+static const SpanFunc textured_span_sse2s[2][2][2] = {
+#define X(name, fog, depth_equal, pow2) [fog][depth_equal][pow2] = textured_span_sse2##name,
+    TEXTURED_VARIANTS(X)
+#undef X
+};
+
+static const SpanFunc textured_span_avx2s[2][2][2] = {
+#define X(name, fog, depth_equal, pow2) [fog][depth_equal][pow2] = textured_span_avx2##name,
+    TEXTURED_VARIANTS(X)
+#undef X
+};
+
+static const VisResolveFunc vis_resolve_avx2s[2][2] = {
+#define X(name, fog, depth_equal, pow2) [fog][pow2] = vis_resolve_avx2##name,
+    RESOLVE_VARIANTS(X)
+#undef X
+};
+#endif
+
+// The span kernels a pipeline can use. Colored spans have no SIMD kernel,
+// and the SSE2 set falls back to scalar where it has none either.
+struct RasterKernels {
+    SpanFunc       depth;
+    SpanFunc       vis;
+    SpanFunc       colored;
+    SpanFunc       textured[2];  // [pow2]
+    VisResolveFunc resolve[2];   // [pow2]
+};
+
+// [simd][fog][depth_equal], filled in by raster_init()
+static RasterKernels raster_kernels[2][2][2];
+static const char *raster_simd_kernel = "scalar";
+
+void raster_init(void) {
+    bool sse2 = false, avx2 = false;
+#if defined(__SSE2__)
+    sse2 = true;
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2");
+#endif
+    raster_simd_kernel = avx2 ? "AVX2" : sse2 ? "SSE2" : "scalar";
+
+    for (int simd = 0; simd < 2; simd++) {
+        for (int fog = 0; fog < 2; fog++) {
+            for (int eq = 0; eq < 2; eq++) {
+                RasterKernels *k = &raster_kernels[simd][fog][eq];
+                k->depth   = depth_span_scalar;
+                k->vis     = vis_span_scalar;
+                k->colored = colored_span_scalars[fog][eq];
+                for (int pow2 = 0; pow2 < 2; pow2++) {
+                    k->textured[pow2] = textured_span_scalars[fog][eq][pow2];
+                    k->resolve[pow2]  = vis_resolve_scalars[fog][pow2];
                 }
-                zbuf[idx] = depth;
-                display_buffer[idx] = final_color;
+                if (!simd) continue;
+#if defined(__SSE2__)
+                k->depth = avx2 ? depth_span_avx2 : depth_span_sse2;
+                if (avx2) k->vis = vis_span_avx2;
+                for (int pow2 = 0; pow2 < 2; pow2++) {
+                    k->textured[pow2] = avx2 ? textured_span_avx2s[fog][eq][pow2]
+                                             : textured_span_sse2s[fog][eq][pow2];
+                    if (avx2) k->resolve[pow2] = vis_resolve_avx2s[fog][pow2];
+                }
+#endif
             }
         }
     }
 }
 
-void raster_textured_triangle(const Chunk * restrict chunk,
-                               int x_min_clip, int x_max_clip) {
-    ScreenVertex v0 = chunk->verts[0];
-    ScreenVertex v1 = chunk->verts[1];
-    ScreenVertex v2 = chunk->verts[2];
-    Vec2 uv0 = chunk->textured.uvs[0];
-    Vec2 uv1 = chunk->textured.uvs[1];
-    Vec2 uv2 = chunk->textured.uvs[2];
-    Texture *tex = chunk->textured.texture;
+void raster_pipeline_init(RasterPipeline *p, RasterDepthTest test, ScreenAABB clip) {
+    p->clip          = clip;
+    p->kernels       = &raster_kernels[g_flags.simd_enabled][g_flags.fog_enabled]
+                                      [test == RASTER_DEPTH_EQUAL];
+    p->tiles         = g_flags.tile_raster;
+    p->solve_spans   = g_flags.simd_enabled;
+    p->hiz           = g_flags.hiz_enabled;
+    p->pow2_textures = g_flags.pow2_textures;
 
-    if (!tex || !tex->pixels) return;
+    if (g_flags.show_wireframe) {
+        p->triangle[CHUNK_COLORED]  = raster_wireframe_triangle;
+        p->triangle[CHUNK_TEXTURED] = raster_wireframe_triangle;
+    } else {
+        p->triangle[CHUNK_COLORED]  = raster_colored_triangle;
+        p->triangle[CHUNK_TEXTURED] = raster_textured_triangle;
+    }
+}
+
+const char *raster_simd_name(void) {
+    return raster_simd_kernel;
+}
+
+static inline void edge_start(const RasterSetup *s, int x, int y, int64_t e[3]) {
+    for (int i = 0; i < 3; i++) {
+        e[i] = s->edge_c[i] + s->edge_dx[i] * (x - s->origin_x)
+                            + s->edge_dy[i] * (y - s->origin_y);
+    }
+}
+
+// Range of k in [0, count) where e + d * k >= 0 for all three edges.
+// Returns false when the row is not covered at all.
+static inline bool edge_span(const int64_t e[3], const int64_t d[3], int count,
+                             int *k_min, int *k_max) {
+    int64_t lo = 0, hi = count - 1;
+    for (int i = 0; i < 3; i++) {
+        if (d[i] > 0) {
+            if (e[i] < 0) {
+                int64_t k = (-e[i] + d[i] - 1) / d[i];
+                if (k > lo) lo = k;
+            }
+        } else if (d[i] < 0) {
+            if (e[i] < 0) return false;
+            int64_t k = e[i] / -d[i];
+            if (k < hi) hi = k;
+        } else if (e[i] < 0) {
+            return false;
+        }
+    }
+    if (lo > hi) return false;
+    *k_min = (int)lo;
+    *k_max = (int)hi;
+    return true;
+}
+
+// Steps the edge equations pixel by pixel. Triangles are convex, so each
+// row holds a single run of covered pixels.
+static void walk_stepped(const RasterSetup *s, int x0, int x1, int y0, int y1,
+                         SpanFunc span, const void *ctx) {
+    int64_t row_e[3];
+    edge_start(s, x0, y0, row_e);
+
+    for (int y = y0; y < y1; y++) {
+        int64_t e0 = row_e[0], e1 = row_e[1], e2 = row_e[2];
+        int x = x0;
+        for (; x < x1 && (e0 | e1 | e2) < 0; x++) {
+            e0 += s->edge_dx[0];
+            e1 += s->edge_dx[1];
+            e2 += s->edge_dx[2];
+        }
+        int run_start = x;
+        for (; x < x1 && (e0 | e1 | e2) >= 0; x++) {
+            e0 += s->edge_dx[0];
+            e1 += s->edge_dx[1];
+            e2 += s->edge_dx[2];
+        }
+        if (x > run_start) span(ctx, y, run_start, x);
 
-    int bb_x_min = maxi((int)floorf(minf(v0.x, minf(v1.x, v2.x))), x_min_clip);
-    int bb_x_max = mini((int)ceilf(maxf(v0.x, maxf(v1.x, v2.x))),  x_max_clip);
-    int bb_y_min = maxi((int)floorf(minf(v0.y, minf(v1.y, v2.y))), 0);
-    int bb_y_max = mini((int)ceilf(maxf(v0.y, maxf(v1.y, v2.y))),  WINDOW_HEIGHT);
+        row_e[0] += s->edge_dy[0];
+        row_e[1] += s->edge_dy[1];
+        row_e[2] += s->edge_dy[2];
+    }
+}
 
-    float area = edge_func(v0, v1, v2.x, v2.y);
-    if (fabsf(area) < 1e-6f) return;
-    float inv_area = 1.0f / area;
+// Solves the edge equations for the covered run of each row directly
+static void walk_solved(const RasterSetup *s, int x0, int x1, int y0, int y1,
+                        SpanFunc span, const void *ctx) {
+    int64_t row_e[3];
+    edge_start(s, x0, y0, row_e);
 
-    // Pre-divide UVs by W for perspective-correct interpolation
-    float u0w = uv0.x * v0.inv_w, v0w = uv0.y * v0.inv_w;
-    float u1w = uv1.x * v1.inv_w, v1w = uv1.y * v1.inv_w;
-    float u2w = uv2.x * v2.inv_w, v2w = uv2.y * v2.inv_w;
+    for (int y = y0; y < y1; y++) {
+        int k0, k1;
+        if (edge_span(row_e, s->edge_dx, x1 - x0, &k0, &k1)) {
+            span(ctx, y, x0 + k0, x0 + k1 + 1);
+        }
+        row_e[0] += s->edge_dy[0];
+        row_e[1] += s->edge_dy[1];
+        row_e[2] += s->edge_dy[2];
+    }
+}
 
-    for (int y = bb_y_min; y < bb_y_max; y++) {
-        for (int x = bb_x_min; x < bb_x_max; x++) {
-            float px = x + 0.5f;
-            float py = y + 0.5f;
+// Emits the rows of a run of adjacent accepted tiles. Runs made only of
+// fully covered tiles need no coverage test at all.
+static void emit_tile_run(const RasterSetup *s, int x0, int x1, int y0, int y1,
+                          bool full, SpanFunc span, const void *ctx) {
+    if (full) {
+        for (int y = y0; y < y1; y++) {
+            span(ctx, y, x0, x1);
+        }
+        return;
+    }
 
-            float w0 = edge_func(v1, v2, px, py) * inv_area;
-            float w1 = edge_func(v2, v0, px, py) * inv_area;
-            float w2 = edge_func(v0, v1, px, py) * inv_area;
+    int64_t e[3];
+    edge_start(s, x0, y0, e);
+    for (int y = y0; y < y1; y++) {
+        int k0, k1;
+        if (edge_span(e, s->edge_dx, x1 - x0, &k0, &k1)) {
+            span(ctx, y, x0 + k0, x0 + k1 + 1);
+        }
+        e[0] += s->edge_dy[0];
+        e[1] += s->edge_dy[1];
+        e[2] += s->edge_dy[2];
+    }
+}
 
-            if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+// Depth planes are evaluated in float, so values inside a tile can stray a
+// few ulps past the extremes computed at its corners
+#define HIZ_EPSILON 1e-6f
 
-            float depth = w0 * v0.z + w1 * v1.z + w2 * v2.z;
+// Walks the screen-aligned RASTER_TILE_SIZE tiles overlapping the box and
+// classifies each from the edge values at its corners: tiles outside any
+// edge are skipped, tiles inside all three edges are filled without
+// per-pixel coverage tests, and partial tiles solve per-row spans.
+// Adjacent accepted tiles are merged so spans stay as wide as possible.
+//
+// With the hierarchical depth buffer enabled, tiles whose stored farthest
+// depth is nearer than anything the triangle could draw there are rejected
+// too, and fully covered tiles pull that farthest depth in.
+static void walk_tiles(const RasterSetup *s, int x0, int x1, int y0, int y1,
+                       ScreenAABB clip, bool hiz, SpanFunc span, const void *ctx) {
+    float z_min = s->z_min - HIZ_EPSILON;
 
-            int idx = y * WINDOW_WIDTH + x;
-            if (depth >= zbuf[idx]) continue;
+    for (int ty = y0 & ~(RASTER_TILE_SIZE - 1); ty < y1; ty += RASTER_TILE_SIZE) {
+        // Classification uses the whole tile, not just the part inside the
+        // bounding box, so fully covered tiles can update the depth bounds
+        int ty0 = maxi(ty, clip.y_min);
+        int ty1 = mini(ty + RASTER_TILE_SIZE, clip.y_max);
+        int cy0 = maxi(ty, y0);
+        int cy1 = mini(ty + RASTER_TILE_SIZE, y1);
 
-            // Perspective-correct UV: interpolate u/w and 1/w, then divide
-            float one_over_w = w0 * v0.inv_w + w1 * v1.inv_w + w2 * v2.inv_w;
-            float w_at_pixel = 1.0f / one_over_w;
+        int64_t e[3], ddy[3];
+        edge_start(s, x0, ty0, e);
+        for (int i = 0; i < 3; i++) {
+            ddy[i] = s->edge_dy[i] * (ty1 - 1 - ty0);
+        }
+        float z_top    = plane_row(s->z, ty0 - s->origin_y);
+        float z_bottom = plane_row(s->z, ty1 - 1 - s->origin_y);
+        float *tile_max = &zbuf_tile_max[(ty / ZBUF_TILE_SIZE) * ZBUF_TILES_X];
 
-            float u = (w0 * u0w + w1 * u1w + w2 * u2w) * w_at_pixel;
-            float v_coord = (w0 * v0w + w1 * v1w + w2 * v2w) * w_at_pixel;
+        int  run_x0 = -1, run_x1 = -1;
+        bool run_full = true;
 
-            u = u - floorf(u);
-            v_coord = v_coord - floorf(v_coord);
+        for (int tx = x0 & ~(RASTER_TILE_SIZE - 1); tx < x1; tx += RASTER_TILE_SIZE) {
+            int tx0 = maxi(tx, clip.x_min);
+            int tx1 = mini(tx + RASTER_TILE_SIZE, clip.x_max);
 
-            int tex_x = (int)(u * tex->width) % tex->width;
-            int tex_y = (int)(v_coord * tex->height) % tex->height;
-            if (tex_x < 0) tex_x += tex->width;
-            if (tex_y < 0) tex_y += tex->height;
+            bool rejected = false, full = true;
+            for (int i = 0; i < 3; i++) {
+                int64_t c   = e[i] + s->edge_dx[i] * (tx0 - x0);
+                int64_t ddx = s->edge_dx[i] * (tx1 - 1 - tx0);
+                int64_t e_min = c + (ddx < 0 ? ddx : 0) + (ddy[i] < 0 ? ddy[i] : 0);
+                int64_t e_max = c + (ddx > 0 ? ddx : 0) + (ddy[i] > 0 ? ddy[i] : 0);
+                if (e_max < 0) rejected = true;
+                if (e_min < 0) full = false;
+            }
 
-            uint32_t texel = tex->pixels[tex_y * tex->width + tex_x];
+            if (!rejected && hiz) {
+                float *zt = &tile_max[tx / ZBUF_TILE_SIZE];
+                if (z_min >= *zt) {
+                    rejected = true;
+                } else {
+                    float c00 = plane_at(z_top,    s->z, tx0 - s->origin_x);
+                    float c10 = plane_at(z_top,    s->z, tx1 - 1 - s->origin_x);
+                    float c01 = plane_at(z_bottom, s->z, tx0 - s->origin_x);
+                    float c11 = plane_at(z_bottom, s->z, tx1 - 1 - s->origin_x);
+                    float near = minf(minf(c00, c10), minf(c01, c11)) - HIZ_EPSILON;
+                    float far  = maxf(maxf(c00, c10), maxf(c01, c11)) + HIZ_EPSILON;
+                    if (near >= *zt) {
+                        rejected = true;
+                    } else if (full && far < *zt &&
+                               tx1 - tx0 == ZBUF_TILE_SIZE && ty1 - ty0 == ZBUF_TILE_SIZE) {
+                        // Every pixel ends up at min(old, new) <= far
+                        *zt = far;
+                    }
+                }
+            }
 
-            if (g_flags.fog_enabled) {
-                float fog_factor = clampf((depth - 0.95f) / (1.0f - 0.95f), 0.0f, 1.0f);
-                texel = color_lerp(texel, COLOR_RGB(30, 30, 50), fog_factor);
+            if (rejected) {
+                if (run_x0 >= 0) {
+                    emit_tile_run(s, run_x0, run_x1, cy0, cy1, run_full, span, ctx);
+                    run_x0 = -1;
+                }
+                continue;
             }
+            if (run_x0 < 0) {
+                run_x0 = maxi(tx0, x0);
+                run_full = true;
+            }
+            run_x1 = mini(tx1, x1);
+            run_full = run_full && full;
+        }
 
-            zbuf[idx] = depth;
-            display_buffer[idx] = texel;
+        if (run_x0 >= 0) {
+            emit_tile_run(s, run_x0, run_x1, cy0, cy1, run_full, span, ctx);
         }
     }
 }
 
-static void draw_line(ScreenVertex a, ScreenVertex b, uint32_t color,
-                      int x_min_clip, int x_max_clip) {
+static void raster_walk(const RasterPipeline *p, const RasterSetup *s,
+                        SpanFunc span, const void *ctx) {
+    int x0 = maxi(s->x_min, p->clip.x_min);
+    int x1 = mini(s->x_max, p->clip.x_max);
+    int y0 = maxi(s->y_min, p->clip.y_min);
+    int y1 = mini(s->y_max, p->clip.y_max);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    if (p->tiles) {
+        walk_tiles(s, x0, x1, y0, y1, p->clip, p->hiz, span, ctx);
+    } else if (p->solve_spans) {
+        walk_solved(s, x0, x1, y0, y1, span, ctx);
+    } else {
+        walk_stepped(s, x0, x1, y0, y1, span, ctx);
+    }
+}
+
+void raster_depth_triangle(const RasterPipeline *p, const Chunk * restrict chunk,
+                           const RasterSetup * restrict s) {
+    DepthSpan sp;
+    sp.pz       = s->z;
+    sp.origin_x = s->origin_x;
+    sp.origin_y = s->origin_y;
+
+    raster_walk(p, s, p->kernels->depth, &sp);
+}
+
+void raster_vis_triangle(const RasterPipeline *p, const Chunk * restrict chunk,
+                         const RasterSetup * restrict s, uint32_t id) {
+    if (chunk->type == CHUNK_TEXTURED &&
+        (!chunk->textured.texture || !chunk->textured.texture->pixels)) return;
+
+    VisSpan sp;
+    sp.pz       = s->z;
+    sp.pb1      = s->bary[1];
+    sp.pb2      = s->bary[2];
+    sp.id       = id;
+    sp.origin_x = s->origin_x;
+    sp.origin_y = s->origin_y;
+
+    raster_walk(p, s, p->kernels->vis, &sp);
+}
+
+void raster_vis_clear(const RasterPipeline *p) {
+    for (int y = p->clip.y_min; y < p->clip.y_max; y++) {
+        VisRecord *row = &vis_buffer[y * WINDOW_WIDTH];
+        for (int x = p->clip.x_min; x < p->clip.x_max; x++) {
+            row[x].chunk = VIS_NONE;
+        }
+    }
+}
+
+// Shades every pixel the visibility pass covered, once, walking each row
+// in runs of pixels that show the same chunk
+void raster_vis_resolve(const RasterPipeline *p, const Chunk * restrict chunks) {
+    for (int y = p->clip.y_min; y < p->clip.y_max; y++) {
+        const VisRecord *row = &vis_buffer[y * WINDOW_WIDTH];
+        int x = p->clip.x_min;
+        while (x < p->clip.x_max) {
+            uint32_t id = row[x].chunk;
+            int run_end = x + 1;
+            while (run_end < p->clip.x_max && row[run_end].chunk == id) run_end++;
+            if (id != VIS_NONE) {
+                const Chunk *chunk = &chunks[id];
+                bool pow2 = chunk->type == CHUNK_TEXTURED &&
+                            texture_use_pow2(p, chunk->textured.texture, chunk->textured.uvs);
+                p->kernels->resolve[pow2](chunk, y * WINDOW_WIDTH + x, run_end - x);
+            }
+            x = run_end;
+        }
+    }
+}
+
+void raster_colored_triangle(const RasterPipeline *p, const Chunk * restrict chunk,
+                             const RasterSetup * restrict s) {
+    ColoredSpan sp;
+    sp.pz       = s->z;
+    sp.color    = chunk->colored.color;
+    sp.origin_x = s->origin_x;
+    sp.origin_y = s->origin_y;
+
+    raster_walk(p, s, p->kernels->colored, &sp);
+}
+
+void raster_textured_triangle(const RasterPipeline *p, const Chunk * restrict chunk,
+                              const RasterSetup * restrict s) {
+    Texture *tex = chunk->textured.texture;
+    if (!tex || !tex->pixels) return;
+
+    TexturedSpan sp;
+    sp.tex      = tex;
+    sp.pz       = s->z;
+    sp.piw      = s->iw;
+    sp.puw      = s->uw;
+    sp.pvw      = s->vw;
+    sp.origin_x = s->origin_x;
+    sp.origin_y = s->origin_y;
+
+    SpanFunc span = p->kernels->textured[texture_use_pow2(p, tex, chunk->textured.uvs)];
+    raster_walk(p, s, span, &sp);
+}
+
+static void draw_line(ScreenVertex a, ScreenVertex b, uint32_t color, ScreenAABB clip) {
     int x0 = (int)a.x, y0 = (int)a.y;
     int x1 = (int)b.x, y1 = (int)b.y;
 
@@ -142,8 +1120,8 @@ static void draw_line(ScreenVertex a, ScreenVertex b, uint32_t color,
     if (steps == 0) steps = 1;
 
     for (int i = 0; i <= steps; i++) {
-        if (x0 >= x_min_clip && x0 < x_max_clip &&
-            y0 >= 0 && y0 < WINDOW_HEIGHT) {
+        if (x0 >= clip.x_min && x0 < clip.x_max &&
+            y0 >= clip.y_min && y0 < clip.y_max) {
             float t = (steps > 0) ? (float)i / (float)steps : 0.0f;
             float depth = a.z + t * (b.z - a.z);
             int idx = y0 * WINDOW_WIDTH + x0;
@@ -160,10 +1138,10 @@ static void draw_line(ScreenVertex a, ScreenVertex b, uint32_t color,
     }
 }
 
-void raster_wireframe_triangle(const Chunk * restrict chunk,
-                                int x_min_clip, int x_max_clip) {
+void raster_wireframe_triangle(const RasterPipeline *p, const Chunk * restrict chunk,
+                               const RasterSetup * restrict s) {
     uint32_t color = COLOR_RGB(0, 255, 0);
-    draw_line(chunk->verts[0], chunk->verts[1], color, x_min_clip, x_max_clip);
-    draw_line(chunk->verts[1], chunk->verts[2], color, x_min_clip, x_max_clip);
-    draw_line(chunk->verts[2], chunk->verts[0], color, x_min_clip, x_max_clip);
+    draw_line(chunk->verts[0], chunk->verts[1], color, p->clip);
+    draw_line(chunk->verts[1], chunk->verts[2], color, p->clip);
+    draw_line(chunk->verts[2], chunk->verts[0], color, p->clip);
 }
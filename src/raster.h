@@ -2,9 +2,70 @@
 #define RASTER_H
 
 #include "chunk.h"
+#include "display.h"
 
-void raster_colored_triangle(const Chunk *chunk, int x_min_clip, int x_max_clip);
-void raster_textured_triangle(const Chunk *chunk, int x_min_clip, int x_max_clip);
-void raster_wireframe_triangle(const Chunk *chunk, int x_min_clip, int x_max_clip);
+// Edge of the square screen tiles used for coarse coverage classification.
+// They coincide with the hierarchical depth tiles, and strip boundaries are
+// aligned to them so no tile is shared between workers.
+#define RASTER_TILE_SIZE ZBUF_TILE_SIZE
+
+typedef enum {
+    RASTER_DEPTH_LESS,   // draw where nearer than zbuf and write depth
+    RASTER_DEPTH_EQUAL,  // draw only where a depth pre-pass left this depth
+} RasterDepthTest;
+
+typedef struct {
+    float c;       // value at the center of the origin pixel
+    float dx, dy;  // change per pixel step
+} Plane;
+
+// Everything about a triangle that does not depend on which region draws
+// it, computed once per chunk and shared by every strip or tile it lands
+// in. Degenerate and guard-band triangles get an empty box.
+typedef struct {
+    int     x_min, x_max;   // covered pixel bounds, max exclusive
+    int     y_min, y_max;
+    int     origin_x, origin_y;
+    int64_t edge_c[3];      // biased edge values at the origin pixel center
+    int64_t edge_dx[3];
+    int64_t edge_dy[3];
+    Plane   bary[3];        // barycentric weight of each vertex
+    Plane   z;
+    float   z_min;          // nearest vertex depth
+    Plane   iw, uw, vw;     // 1/w, u/w and v/w, for textured chunks only
+} RasterSetup;
+
+typedef struct RasterKernels  RasterKernels;
+typedef struct RasterPipeline RasterPipeline;
+typedef void (*RasterTriangleFunc)(const RasterPipeline *p, const Chunk *chunk,
+                                   const RasterSetup *s);
+
+// Kernel and walker choices for the current flags, resolved once per
+// bucket so chunks dispatch through one indexed call and nothing below
+// reads g_flags
+struct RasterPipeline {
+    RasterTriangleFunc   triangle[CHUNK_TYPE_COUNT];  // shading pass, by chunk type
+    const RasterKernels *kernels;
+    ScreenAABB           clip;  // pixels the bucket owns, max exclusive
+    bool                 tiles;
+    bool                 solve_spans;
+    bool                 hiz;
+    bool                 pow2_textures;
+};
+
+void        raster_init(void);
+const char *raster_simd_name(void);
+void        raster_pipeline_init(RasterPipeline *p, RasterDepthTest test, ScreenAABB clip);
+
+void raster_setup(const Chunk *chunk, RasterSetup *s);
+
+void raster_depth_triangle(const RasterPipeline *p, const Chunk *chunk, const RasterSetup *s);
+void raster_vis_clear(const RasterPipeline *p);
+void raster_vis_triangle(const RasterPipeline *p, const Chunk *chunk, const RasterSetup *s,
+                         uint32_t id);
+void raster_vis_resolve(const RasterPipeline *p, const Chunk *chunks);
+void raster_colored_triangle(const RasterPipeline *p, const Chunk *chunk, const RasterSetup *s);
+void raster_textured_triangle(const RasterPipeline *p, const Chunk *chunk, const RasterSetup *s);
+void raster_wireframe_triangle(const RasterPipeline *p, const Chunk *chunk, const RasterSetup *s);
 
 #endif // RASTER_H
@@ -1,5 +1,6 @@
 #include "scene.h"
 #include "display.h"
+#include "flags.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -58,6 +59,8 @@ Texture *texture_load_bmp(const char *path) {
     tex->width  = width;
     tex->height = height;
     tex->pixels = malloc(width * height * sizeof(uint32_t));
+    tex->pow2   = false;
+    tex->mip    = NULL;
 
     for (int y = 0; y < height; y++) {
         if (fread(row_data, 1, row_size, f) != (size_t)row_size) break;
@@ -89,6 +92,8 @@ static Texture *texture_load_png(const char *path) {
     tex->width  = w;
     tex->height = h;
     tex->pixels = malloc(w * h * sizeof(uint32_t));
+    tex->pow2   = false;
+    tex->mip    = NULL;
 
     for (int i = 0; i < w * h; i++) {
         unsigned char r = data[i * 4 + 0];
@@ -101,13 +106,124 @@ static Texture *texture_load_png(const char *path) {
     return tex;
 }
 
+// Rearranges row-major texels into the blocked layout the rasterizer samples
+static void texture_swizzle(Texture *tex) {
+    int count = texture_blocks_x(tex) * texture_blocks_y(tex) * TEXTURE_BLOCK * TEXTURE_BLOCK;
+    uint32_t *blocked = calloc(count, sizeof(uint32_t));
+
+    for (int y = 0; y < tex->height; y++) {
+        for (int x = 0; x < tex->width; x++) {
+            blocked[texture_offset(tex, x, y)] = tex->pixels[y * tex->width + x];
+        }
+    }
+
+    free(tex->pixels);
+    tex->pixels = blocked;
+}
+
+// Box-filters a row-major level down to half size. Odd sizes drop their
+// last row or column; a size of 1 stays 1 by repeating it.
+static Texture *texture_downsample(const Texture *src) {
+    Texture *dst = malloc(sizeof(Texture));
+    dst->width  = src->width  > 1 ? src->width  / 2 : 1;
+    dst->height = src->height > 1 ? src->height / 2 : 1;
+    dst->pixels = malloc(dst->width * dst->height * sizeof(uint32_t));
+    dst->pow2   = false;
+    dst->mip    = NULL;
+
+    for (int y = 0; y < dst->height; y++) {
+        int y0 = mini(2 * y, src->height - 1);
+        int y1 = mini(2 * y + 1, src->height - 1);
+        for (int x = 0; x < dst->width; x++) {
+            int x0 = mini(2 * x, src->width - 1);
+            int x1 = mini(2 * x + 1, src->width - 1);
+            uint32_t c[4] = {
+                src->pixels[y0 * src->width + x0], src->pixels[y0 * src->width + x1],
+                src->pixels[y1 * src->width + x0], src->pixels[y1 * src->width + x1],
+            };
+            uint32_t out = 0xFF000000;
+            for (int shift = 0; shift <= 16; shift += 8) {
+                uint32_t sum = 2;
+                for (int i = 0; i < 4; i++) sum += (c[i] >> shift) & 0xFF;
+                out |= (sum / 4) << shift;
+            }
+            dst->pixels[y * dst->width + x] = out;
+        }
+    }
+    return dst;
+}
+
+static void texture_free(Texture *tex) {
+    while (tex) {
+        Texture *next = tex->mip;
+        free(tex->pixels);
+        free(tex);
+        tex = next;
+    }
+}
+
 Texture *texture_load(const char *path) {
     if (!path) return NULL;
     size_t len = strlen(path);
+    Texture *tex;
     if (len >= 4 && strcmp(path + len - 4, ".png") == 0) {
-        return texture_load_png(path);
+        tex = texture_load_png(path);
+    } else {
+        tex = texture_load_bmp(path);
     }
-    return texture_load_bmp(path);
+    if (!tex) return NULL;
+
+    // Mip chain down to 1x1, filtered from row-major texels before blocking
+    for (Texture *level = tex; level->width > 1 || level->height > 1; level = level->mip) {
+        level->mip = texture_downsample(level);
+    }
+    for (Texture *level = tex; level; level = level->mip) {
+        texture_swizzle(level);
+        level->pow2 = (level->width  & (level->width  - 1)) == 0 &&
+                      (level->height & (level->height - 1)) == 0;
+    }
+    return tex;
+}
+
+// Picks the mip level whose texels come closest to one per pixel without
+// going below, from the triangle's texel area over its screen area. Both
+// areas are doubled, so the factor cancels.
+static Texture *texture_select_mip(Texture *tex, Vec2 uv0, Vec2 uv1, Vec2 uv2,
+                                   float screen_area) {
+    float uv_area = fabsf((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv1.y - uv0.y) * (uv2.x - uv0.x));
+    float texel_area = uv_area * (float)tex->width * (float)tex->height;
+    if (!(texel_area > screen_area)) return tex;
+
+    // Each level quarters the texel area
+    int level = (int)(0.5f * log2f(texel_area / screen_area));
+    for (; level > 0 && tex->mip; level--) {
+        tex = tex->mip;
+    }
+    return tex;
+}
+
+// Centered on the vertices' box, which is not the tightest sphere but is
+// close for the boxy and round models the scene uses
+static void model_compute_bounds(Model *model) {
+    model->bound_center = vec3(0.0f, 0.0f, 0.0f);
+    model->bound_radius = 0.0f;
+    if (model->vertex_count == 0) return;
+
+    Vec3 lo = model->vertices[0];
+    Vec3 hi = model->vertices[0];
+    for (int i = 1; i < model->vertex_count; i++) {
+        Vec3 v = model->vertices[i];
+        lo = vec3(minf(lo.x, v.x), minf(lo.y, v.y), minf(lo.z, v.z));
+        hi = vec3(maxf(hi.x, v.x), maxf(hi.y, v.y), maxf(hi.z, v.z));
+    }
+    Vec3 center = vec3_scale(vec3_add(lo, hi), 0.5f);
+
+    float radius = 0.0f;
+    for (int i = 0; i < model->vertex_count; i++) {
+        radius = maxf(radius, vec3_length(vec3_sub(model->vertices[i], center)));
+    }
+    model->bound_center = center;
+    model->bound_radius = radius;
 }
 
 // --- OBJ Loader ---
@@ -227,6 +343,7 @@ Model *scene_load_model(Scene *scene, const char *obj_path, const char *texture_
     }
 
     fclose(f);
+    model_compute_bounds(model);
 
     // Load texture
     model->texture = NULL;
@@ -445,110 +562,255 @@ static uint32_t face_color_from_index(int face_idx) {
     return COLOR_RGB(r, g, b);
 }
 
-void scene_generate_chunks(const Scene *scene, const Mat4 *vp, Arena *arena,
-                           Chunk *chunks, int *chunk_count, int max_chunks) {
-    (void)arena;
-    *chunk_count = 0;
+// Appends the chunks of faces [face_first, face_last) of one object to
+// out, in face order. Once it is full the rest are only counted as dropped.
+static void scene_emit_faces(const SceneObject *obj, const Mat4 *vp,
+                             int face_first, int face_last, ChunkStream *out) {
+    const Model *model = obj->model;
+    Mat4 model_mat = scene_object_model_matrix(obj);
+    Mat4 mvp = mat4_multiply(*vp, model_mat);
+
+    for (int f = face_first; f < face_last; f++) {
+        int vi0 = model->face_verts[f * 3 + 0];
+        int vi1 = model->face_verts[f * 3 + 1];
+        int vi2 = model->face_verts[f * 3 + 2];
+
+        Vec3 v0 = model->vertices[vi0];
+        Vec3 v1 = model->vertices[vi1];
+        Vec3 v2 = model->vertices[vi2];
+
+        Vec4 clip0 = mat4_mul_vec4(mvp, vec4_from_vec3(v0, 1.0f));
+        Vec4 clip1 = mat4_mul_vec4(mvp, vec4_from_vec3(v1, 1.0f));
+        Vec4 clip2 = mat4_mul_vec4(mvp, vec4_from_vec3(v2, 1.0f));
+
+        // Get UVs
+        bool has_uvs = model->texture != NULL && model->uvs != NULL;
+        Vec2 uv0 = {0}, uv1 = {0}, uv2 = {0};
+        if (has_uvs) {
+            int ui0 = model->face_uvs[f * 3 + 0];
+            int ui1 = model->face_uvs[f * 3 + 1];
+            int ui2 = model->face_uvs[f * 3 + 2];
+            if (ui0 >= 0 && ui0 < model->uv_count) uv0 = model->uvs[ui0];
+            if (ui1 >= 0 && ui1 < model->uv_count) uv1 = model->uvs[ui1];
+            if (ui2 >= 0 && ui2 < model->uv_count) uv2 = model->uvs[ui2];
+        }
+
+        // Near-plane clipping
+        Vec4 clip_in[3] = { clip0, clip1, clip2 };
+        Vec2 uv_in[3] = { uv0, uv1, uv2 };
+        Vec4 clip_out[2][3];
+        Vec2 uv_out[2][3];
+        int tri_count;
+        clip_triangle(clip_in, uv_in, has_uvs, 0.1f, clip_out, uv_out, &tri_count);
+
+        for (int t = 0; t < tri_count; t++) {
+            Vec3 ndc0 = vec4_perspective_divide(clip_out[t][0]);
+            Vec3 ndc1 = vec4_perspective_divide(clip_out[t][1]);
+            Vec3 ndc2 = vec4_perspective_divide(clip_out[t][2]);
+
+            // Viewport transform
+            float sx0 = (ndc0.x + 1.0f) * 0.5f * WINDOW_WIDTH;
+            float sy0 = (1.0f - ndc0.y) * 0.5f * WINDOW_HEIGHT;
+            float sz0 = (ndc0.z + 1.0f) * 0.5f;
+
+            float sx1 = (ndc1.x + 1.0f) * 0.5f * WINDOW_WIDTH;
+            float sy1 = (1.0f - ndc1.y) * 0.5f * WINDOW_HEIGHT;
+            float sz1 = (ndc1.z + 1.0f) * 0.5f;
+
+            float sx2 = (ndc2.x + 1.0f) * 0.5f * WINDOW_WIDTH;
+            float sy2 = (1.0f - ndc2.y) * 0.5f * WINDOW_HEIGHT;
+            float sz2 = (ndc2.z + 1.0f) * 0.5f;
+
+            // Backface cull (cross_z < 0 means CW in screen space = front-facing)
+            float edge1_x = sx1 - sx0;
+            float edge1_y = sy1 - sy0;
+            float edge2_x = sx2 - sx0;
+            float edge2_y = sy2 - sy0;
+            float cross_z = edge1_x * edge2_y - edge1_y * edge2_x;
+            if (cross_z >= 0) continue;
+
+            // 1/w for perspective-correct interpolation
+            float iw0 = 1.0f / clip_out[t][0].w;
+            float iw1 = 1.0f / clip_out[t][1].w;
+            float iw2 = 1.0f / clip_out[t][2].w;
+
+            // Swap verts 1 and 2 so the rasterizer receives CCW winding
+            Chunk spare;
+            Chunk *chunk = out->count < out->capacity ? &out->chunks[out->count] : &spare;
+            chunk->verts[0] = (ScreenVertex){ sx0, sy0, sz0, iw0 };
+            chunk->verts[1] = (ScreenVertex){ sx2, sy2, sz2, iw2 };
+            chunk->verts[2] = (ScreenVertex){ sx1, sy1, sz1, iw1 };
+
+            if (has_uvs) {
+                chunk->type = CHUNK_TEXTURED;
+                chunk->textured.texture = model->texture;
+                if (g_flags.mipmaps) {
+                    chunk->textured.texture = texture_select_mip(
+                        model->texture, uv_out[t][0], uv_out[t][1], uv_out[t][2], -cross_z);
+                }
+                chunk->textured.uvs[0] = uv_out[t][0];
+                chunk->textured.uvs[1] = uv_out[t][2];
+                chunk->textured.uvs[2] = uv_out[t][1];
+            } else {
+                chunk->type = CHUNK_COLORED;
+                chunk->colored.color = face_color_from_index(f);
+            }
+
+            if (chunk == &spare) {
+                out->dropped++;
+            } else {
+                chunk_stream_commit(out);
+            }
+        }
+    }
+}
+
+static bool scene_object_drawn(const SceneObject *obj) {
+    return obj->visible && obj->model;
+}
 
+static int scene_drawn_face_count(const Scene *scene) {
+    int face_count = 0;
     for (int obj_i = 0; obj_i < scene->object_count; obj_i++) {
         const SceneObject *obj = &scene->objects[obj_i];
-        if (!obj->visible) continue;
-        const Model *model = obj->model;
-        if (!model) continue;
+        if (scene_object_drawn(obj)) face_count += obj->model->face_count;
+    }
+    return face_count;
+}
 
-        Mat4 model_mat = scene_object_model_matrix(obj);
-        Mat4 mvp = mat4_multiply(*vp, model_mat);
+int scene_chunk_capacity(const Scene *scene) {
+    // Near-plane clipping emits at most two triangles per face
+    return 2 * scene_drawn_face_count(scene);
+}
 
-        for (int f = 0; f < model->face_count; f++) {
-            if (*chunk_count >= max_chunks) return;
+typedef struct {
+    const Scene *scene;
+    const Mat4  *vp;
+    const bool  *drawn;       // per object, after culling
+    int          face_count;  // over all drawn objects
+    ChunkStream *regions;     // one per worker, in the frame arena
+} ChunkGenJob;
+
+// One worker's share of the faces of all drawn objects, taken in the same
+// order as the serial loop so the merged output matches it exactly
+static void scene_chunk_job(StripPool *pool, void *arg, int worker) {
+    ChunkGenJob *job = (ChunkGenJob *)arg;
+    int first = (int)((int64_t)worker * job->face_count / pool->thread_count);
+    int last  = (int)((int64_t)(worker + 1) * job->face_count / pool->thread_count);
+    ChunkStream *out = &job->regions[worker];
+
+    int base = 0;
+    for (int obj_i = 0; obj_i < job->scene->object_count && base < last; obj_i++) {
+        const SceneObject *obj = &job->scene->objects[obj_i];
+        if (!job->drawn[obj_i]) continue;
+        int faces = obj->model->face_count;
+        int f0 = maxi(first - base, 0);
+        int f1 = mini(last - base, faces);
+        if (f0 < f1) {
+            scene_emit_faces(obj, job->vp, f0, f1, out);
+        }
+        base += faces;
+    }
+}
 
-            int vi0 = model->face_verts[f * 3 + 0];
-            int vi1 = model->face_verts[f * 3 + 1];
-            int vi2 = model->face_verts[f * 3 + 2];
+// Fans face ranges out over the pool's workers into per-worker arena
+// regions, then compacts them into the stream in worker order. Returns
+// false, leaving the stream untouched, when the arena cannot hold the
+// regions.
+static bool scene_generate_chunks_parallel(const Scene *scene, const Mat4 *vp, Arena *arena,
+                                           StripPool *pool, const bool *drawn, int face_count,
+                                           ChunkStream *stream) {
+    int workers = pool->thread_count;
+
+    // Each region fits its faces' worst case, as in scene_chunk_capacity()
+    int faces_per_worker = (face_count + workers - 1) / workers;
+    int capacity = mini(2 * faces_per_worker, stream->capacity - stream->count);
+    size_t total = (size_t)workers * capacity;
+
+    ChunkGenJob job = {
+        .scene      = scene,
+        .vp         = vp,
+        .drawn      = drawn,
+        .face_count = face_count,
+        .regions    = arena_try_alloc(arena, workers * sizeof(ChunkStream)),
+    };
+    Chunk       *chunks = arena_try_alloc(arena, total * sizeof(Chunk));
+    float       *depth  = arena_try_alloc(arena, total * sizeof(float));
+    ChunkBounds *bounds = arena_try_alloc(arena, total * sizeof(ChunkBounds));
+    if (!job.regions || !chunks || !depth || !bounds) return false;
+    for (int w = 0; w < workers; w++) {
+        size_t at = (size_t)w * capacity;
+        job.regions[w] = (ChunkStream){
+            .chunks   = chunks + at,
+            .depth    = depth + at,
+            .bounds   = bounds + at,
+            .capacity = capacity,
+        };
+    }
 
-            Vec3 v0 = model->vertices[vi0];
-            Vec3 v1 = model->vertices[vi1];
-            Vec3 v2 = model->vertices[vi2];
+    strip_pool_run(pool, scene_chunk_job, &job);
+
+    // Past capacity, whole regions and the tail of the one that crossed it
+    // are dropped, the same chunks the serial loop would have dropped
+    for (int w = 0; w < workers; w++) {
+        const ChunkStream *region = &job.regions[w];
+        int n  = mini(region->count, stream->capacity - stream->count);
+        int at = stream->count;
+        memcpy(&stream->chunks[at], region->chunks, n * sizeof(Chunk));
+        memcpy(&stream->depth[at],  region->depth,  n * sizeof(float));
+        memcpy(&stream->bounds[at], region->bounds, n * sizeof(ChunkBounds));
+        stream->count   += n;
+        stream->dropped += region->count - n + region->dropped;
+    }
+    return true;
+}
 
-            Vec4 clip0 = mat4_mul_vec4(mvp, vec4_from_vec3(v0, 1.0f));
-            Vec4 clip1 = mat4_mul_vec4(mvp, vec4_from_vec3(v1, 1.0f));
-            Vec4 clip2 = mat4_mul_vec4(mvp, vec4_from_vec3(v2, 1.0f));
+// Marks the objects to generate chunks for: drawn at all, and with their
+// bounding sphere not wholly outside the view. Returns how many were
+// dropped for the second reason.
+static int scene_cull_objects(const Scene *scene, const Mat4 *vp, bool *drawn) {
+    Frustum frustum = frustum_from_matrix(*vp);
+    int culled = 0;
+    for (int obj_i = 0; obj_i < scene->object_count; obj_i++) {
+        const SceneObject *obj = &scene->objects[obj_i];
+        drawn[obj_i] = scene_object_drawn(obj);
+        if (!drawn[obj_i] || !g_flags.frustum_cull) continue;
 
-            // Get UVs
-            bool has_uvs = model->texture != NULL && model->uvs != NULL;
-            Vec2 uv0 = {0}, uv1 = {0}, uv2 = {0};
-            if (has_uvs) {
-                int ui0 = model->face_uvs[f * 3 + 0];
-                int ui1 = model->face_uvs[f * 3 + 1];
-                int ui2 = model->face_uvs[f * 3 + 2];
-                if (ui0 >= 0 && ui0 < model->uv_count) uv0 = model->uvs[ui0];
-                if (ui1 >= 0 && ui1 < model->uv_count) uv1 = model->uvs[ui1];
-                if (ui2 >= 0 && ui2 < model->uv_count) uv2 = model->uvs[ui2];
-            }
+        // Rotation keeps lengths, so only the largest scale axis grows the radius
+        const Model *model = obj->model;
+        Mat4 model_mat = scene_object_model_matrix(obj);
+        Vec4 center = mat4_mul_vec4(model_mat, vec4_from_vec3(model->bound_center, 1.0f));
+        float scale = maxf(fabsf(obj->scale.x), maxf(fabsf(obj->scale.y), fabsf(obj->scale.z)));
+        if (frustum_culls_sphere(&frustum, vec3(center.x, center.y, center.z),
+                                 model->bound_radius * scale)) {
+            drawn[obj_i] = false;
+            culled++;
+        }
+    }
+    return culled;
+}
 
-            // Near-plane clipping
-            Vec4 clip_in[3] = { clip0, clip1, clip2 };
-            Vec2 uv_in[3] = { uv0, uv1, uv2 };
-            Vec4 clip_out[2][3];
-            Vec2 uv_out[2][3];
-            int tri_count;
-            clip_triangle(clip_in, uv_in, has_uvs, 0.1f, clip_out, uv_out, &tri_count);
-
-            for (int t = 0; t < tri_count; t++) {
-                if (*chunk_count >= max_chunks) return;
-
-                Vec3 ndc0 = vec4_perspective_divide(clip_out[t][0]);
-                Vec3 ndc1 = vec4_perspective_divide(clip_out[t][1]);
-                Vec3 ndc2 = vec4_perspective_divide(clip_out[t][2]);
-
-                // Viewport transform
-                float sx0 = (ndc0.x + 1.0f) * 0.5f * WINDOW_WIDTH;
-                float sy0 = (1.0f - ndc0.y) * 0.5f * WINDOW_HEIGHT;
-                float sz0 = (ndc0.z + 1.0f) * 0.5f;
-
-                float sx1 = (ndc1.x + 1.0f) * 0.5f * WINDOW_WIDTH;
-                float sy1 = (1.0f - ndc1.y) * 0.5f * WINDOW_HEIGHT;
-                float sz1 = (ndc1.z + 1.0f) * 0.5f;
-
-                float sx2 = (ndc2.x + 1.0f) * 0.5f * WINDOW_WIDTH;
-                float sy2 = (1.0f - ndc2.y) * 0.5f * WINDOW_HEIGHT;
-                float sz2 = (ndc2.z + 1.0f) * 0.5f;
-
-                // Backface cull (cross_z < 0 means CW in screen space = front-facing)
-                float edge1_x = sx1 - sx0;
-                float edge1_y = sy1 - sy0;
-                float edge2_x = sx2 - sx0;
-                float edge2_y = sy2 - sy0;
-                float cross_z = edge1_x * edge2_y - edge1_y * edge2_x;
-                if (cross_z >= 0) continue;
-
-                // 1/w for perspective-correct interpolation
-                float iw0 = 1.0f / clip_out[t][0].w;
-                float iw1 = 1.0f / clip_out[t][1].w;
-                float iw2 = 1.0f / clip_out[t][2].w;
-
-                // Swap verts 1 and 2 so the rasterizer receives CCW winding
-                Chunk *chunk = &chunks[*chunk_count];
-                chunk->verts[0] = (ScreenVertex){ sx0, sy0, sz0, iw0 };
-                chunk->verts[1] = (ScreenVertex){ sx2, sy2, sz2, iw2 };
-                chunk->verts[2] = (ScreenVertex){ sx1, sy1, sz1, iw1 };
-                chunk->depth_sort_key = minf(sz0, minf(sz1, sz2));
-
-                if (has_uvs) {
-                    chunk->type = CHUNK_TEXTURED;
-                    chunk->textured.texture = model->texture;
-                    chunk->textured.uvs[0] = uv_out[t][0];
-                    chunk->textured.uvs[1] = uv_out[t][2];
-                    chunk->textured.uvs[2] = uv_out[t][1];
-                } else {
-                    chunk->type = CHUNK_COLORED;
-                    chunk->colored.color = face_color_from_index(f);
-                }
+int scene_generate_chunks(const Scene *scene, const Mat4 *vp, Arena *arena, StripPool *pool,
+                          ChunkStream *stream) {
+    bool drawn[MAX_SCENE_OBJECTS];
+    int culled = scene_cull_objects(scene, vp, drawn);
 
-                (*chunk_count)++;
-            }
-        }
+    int face_count = 0;
+    for (int obj_i = 0; obj_i < scene->object_count; obj_i++) {
+        if (drawn[obj_i]) face_count += scene->objects[obj_i].model->face_count;
     }
+
+    if (g_flags.parallel_chunks && pool && face_count >= SCENE_PARALLEL_MIN_FACES &&
+        scene_generate_chunks_parallel(scene, vp, arena, pool, drawn, face_count, stream)) {
+        return culled;
+    }
+
+    for (int obj_i = 0; obj_i < scene->object_count; obj_i++) {
+        const SceneObject *obj = &scene->objects[obj_i];
+        if (!drawn[obj_i]) continue;
+        scene_emit_faces(obj, vp, 0, obj->model->face_count, stream);
+    }
+    return culled;
 }
 
 void scene_destroy(Scene *scene) {
@@ -558,10 +820,7 @@ void scene_destroy(Scene *scene) {
         free(m->uvs);
         free(m->face_verts);
         free(m->face_uvs);
-        if (m->texture) {
-            free(m->texture->pixels);
-            free(m->texture);
-        }
+        texture_free(m->texture);
     }
     memset(scene, 0, sizeof(Scene));
 }
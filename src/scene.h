@@ -4,6 +4,7 @@
 #include "math_utils.h"
 #include "chunk.h"
 #include "arena.h"
+#include "strip.h"
 
 #define MAX_MODELS 32
 
@@ -16,6 +17,8 @@ typedef struct {
     int   uv_count;
     int   face_count;
     Texture *texture;
+    Vec3  bound_center;  // sphere around every vertex, in model space
+    float bound_radius;
 } Model;
 
 typedef struct {
@@ -41,6 +44,9 @@ typedef struct {
 
 #define MAX_SCENE_OBJECTS 256
 
+// Below this many faces chunk generation stays on the calling thread
+#define SCENE_PARALLEL_MIN_FACES 256
+
 typedef struct Scene {
     SceneObject objects[MAX_SCENE_OBJECTS];
     int         object_count;
@@ -54,12 +60,17 @@ int     scene_add_object(Scene *scene, Model *model, Vec3 position, Vec3 rotatio
 void    scene_object_set_solid(Scene *scene, int idx);
 AABB    scene_object_compute_aabb(const SceneObject *obj);
 void    scene_update(Scene *scene, float dt);
-void    scene_generate_chunks(const Scene *scene, const Mat4 *vp, Arena *arena,
-                              Chunk *chunks, int *chunk_count, int max_chunks);
+// Most chunks the drawn objects can produce in one frame
+int     scene_chunk_capacity(const Scene *scene);
+// Appends to stream until it is full, counting the rest in stream->dropped.
+// pool may be NULL; with it, faces are split across its workers. Returns
+// the number of objects skipped as outside the view frustum.
+int     scene_generate_chunks(const Scene *scene, const Mat4 *vp, Arena *arena, StripPool *pool,
+                              ChunkStream *stream);
 void    scene_destroy(Scene *scene);
 
-Texture *texture_load_bmp(const char *path);
-Texture *texture_load(const char *path);
+Texture *texture_load_bmp(const char *path);  // row-major texels
+Texture *texture_load(const char *path);      // blocked texels, for rendering
 Mat4     scene_object_model_matrix(const SceneObject *obj);
 
 #endif // SCENE_H
@@ -1,145 +1,777 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  // syscall(), for futexes
+#endif
+
 #include "strip.h"
 #include "raster.h"
 #include "display.h"
 #include "flags.h"
+#include "timing.h"
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+_Static_assert(STRIP_TILE_SIZE % RASTER_TILE_SIZE == 0,
+               "work-stealing tiles must not split raster tiles");
+_Static_assert(STRIP_ALIGN % RASTER_TILE_SIZE == 0,
+               "strip boundaries must not split raster tiles");
 
 typedef struct {
     StripPool *pool;
     int        strip_index;
 } WorkerArg;
 
+static ScreenAABB strip_rect(const Strip *strip) {
+    return (ScreenAABB){ strip->x_start, strip->x_end, strip->y_start, strip->y_end };
+}
+
+// The chunk's shared setup record, or one computed into local when the
+// frame arena had no room for the records
+static inline const RasterSetup *strip_chunk_setup(const StripPool *pool, uint32_t index,
+                                                   RasterSetup *local) {
+    if (pool->setups) return &pool->setups[index];
+    raster_setup(&pool->chunks[index], local);
+    return local;
+}
+
+static void strip_render_forward(const StripPool *pool, const Strip *strip) {
+    bool prepass = g_flags.depth_prepass && !g_flags.show_wireframe;
+    RasterPipeline pipe;
+    raster_pipeline_init(&pipe, prepass ? RASTER_DEPTH_EQUAL : RASTER_DEPTH_LESS,
+                         strip_rect(strip));
+
+    // Depth pre-pass: settle the final depth of every pixel first, so
+    // the shading pass below fetches texels once per visible pixel
+    RasterSetup local;
+    if (prepass) {
+        for (int i = 0; i < strip->bucket_count; i++) {
+            uint32_t index = strip->bucket[i];
+            raster_depth_triangle(&pipe, &pool->chunks[index],
+                                  strip_chunk_setup(pool, index, &local));
+        }
+    }
+
+    for (int i = 0; i < strip->bucket_count; i++) {
+        uint32_t index = strip->bucket[i];
+        const Chunk *chunk = &pool->chunks[index];
+        pipe.triangle[chunk->type](&pipe, chunk, strip_chunk_setup(pool, index, &local));
+    }
+}
+
+// Visibility buffer: rasterize depth and chunk ids only, then shade each
+// visible pixel of the region once
+static void strip_render_vis(const StripPool *pool, const Strip *strip) {
+    RasterPipeline pipe;
+    raster_pipeline_init(&pipe, RASTER_DEPTH_LESS, strip_rect(strip));
+
+    raster_vis_clear(&pipe);
+    RasterSetup local;
+    for (int i = 0; i < strip->bucket_count; i++) {
+        uint32_t index = strip->bucket[i];
+        raster_vis_triangle(&pipe, &pool->chunks[index],
+                            strip_chunk_setup(pool, index, &local), index);
+    }
+    raster_vis_resolve(&pipe, pool->chunks);
+}
+
+// Returns the seconds spent clearing the region
+static double strip_render(const StripPool *pool, const Strip *strip) {
+    // Clearing here splits the work across workers and leaves the region
+    // in this core's cache for the rasterizer
+    double clear_time = 0.0;
+    if (pool->clear) {
+        double t0 = timing_now();
+        display_clear_rect(strip->x_start, strip->x_end, strip->y_start, strip->y_end,
+                           pool->clear_color);
+        clear_time = timing_now() - t0;
+    }
+
+    if (g_flags.vis_buffer && !g_flags.show_wireframe) {
+        strip_render_vis(pool, strip);
+    } else {
+        strip_render_forward(pool, strip);
+    }
+    return clear_time;
+}
+
+static inline uint64_t queue_range(uint32_t head, uint32_t tail) {
+    return ((uint64_t)tail << 32) | head;
+}
+
+// Tiles only ever leave a queue during a frame, so a range never repeats
+// and a successful compare-and-swap cannot act on a stale one
+static int queue_pop_front(StripQueue *q) {
+    uint64_t r = atomic_load_explicit(&q->range, memory_order_relaxed);
+    for (;;) {
+        uint32_t head = (uint32_t)r, tail = (uint32_t)(r >> 32);
+        if (head >= tail) return -1;
+        if (atomic_compare_exchange_weak_explicit(&q->range, &r, queue_range(head + 1, tail),
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return (int)head;
+        }
+    }
+}
+
+static int queue_pop_back(StripQueue *q) {
+    uint64_t r = atomic_load_explicit(&q->range, memory_order_relaxed);
+    for (;;) {
+        uint32_t head = (uint32_t)r, tail = (uint32_t)(r >> 32);
+        if (head >= tail) return -1;
+        if (atomic_compare_exchange_weak_explicit(&q->range, &r, queue_range(head, tail - 1),
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return (int)(tail - 1);
+        }
+    }
+}
+
+// Next tile for a worker: its own, front to back, then stolen from the far
+// end of the other workers' ranges. With nothing ever added mid-frame, one
+// empty pass over all queues means the frame is done.
+static int strip_pool_claim(StripPool *pool, int self) {
+    StripQueue *own = &pool->queues[self];
+    int tile = queue_pop_front(own);
+    if (tile >= 0) return tile;
+
+    for (int i = 1; i < pool->thread_count; i++) {
+        tile = queue_pop_back(&pool->queues[(self + i) % pool->thread_count]);
+        if (tile >= 0) {
+            own->tiles_stolen++;
+            return tile;
+        }
+    }
+    return -1;
+}
+
+static inline void strip_cpu_relax(void) {
+#if defined(__SSE2__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Parking: sleep until *word is no longer seen. Wakers change the word
+// first and only call strip_wake() if someone has announced it is parked,
+// with sequentially consistent accesses on both sides so neither misses
+// the other.
+#if defined(__linux__)
+static void strip_park(StripPool *pool, _Atomic uint32_t *word, uint32_t seen) {
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+}
+
+static void strip_wake(StripPool *pool, _Atomic uint32_t *word) {
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+#else
+static void strip_park(StripPool *pool, _Atomic uint32_t *word, uint32_t seen) {
+    pthread_mutex_lock(&pool->mutex);
+    while (atomic_load(word) == seen) {
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void strip_wake(StripPool *pool, _Atomic uint32_t *word) {
+    pthread_mutex_lock(&pool->mutex);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+#endif
+
+// Waits for *word to differ from seen: spin a while, then park, counted
+// in parked so wakers know a syscall is needed
+static uint32_t strip_await_change(StripPool *pool, _Atomic uint32_t *word, uint32_t seen,
+                                   _Atomic uint32_t *parked, int spin) {
+    uint32_t v;
+    for (int i = 0; i < spin; i++) {
+        v = atomic_load_explicit(word, memory_order_acquire);
+        if (v != seen) return v;
+        strip_cpu_relax();
+    }
+    while ((v = atomic_load(word)) == seen) {
+        atomic_fetch_add(parked, 1);
+        strip_park(pool, word, seen);
+        atomic_fetch_sub(parked, 1);
+    }
+    return v;
+}
+
+static void strip_wake_parked(StripPool *pool, _Atomic uint32_t *word, _Atomic uint32_t *parked) {
+    if (atomic_load(parked) > 0) {
+        strip_wake(pool, word);
+    }
+}
+
 static void *strip_worker_func(void *arg) {
     WorkerArg *wa = (WorkerArg *)arg;
     StripPool *pool = wa->pool;
     int si = wa->strip_index;
-    int local_gen = 0;
+    free(wa);
+    uint32_t seen = 0;
+    int      spin = 0;
 
     while (1) {
-        pthread_mutex_lock(&pool->mutex);
-        while (pool->generation == local_gen && !pool->shutdown) {
-            pthread_cond_wait(&pool->cond_work, &pool->mutex);
-        }
-        if (pool->shutdown) {
-            pthread_mutex_unlock(&pool->mutex);
+        seen = strip_await_change(pool, &pool->generation, seen, &pool->workers_parked, spin);
+        if (atomic_load_explicit(&pool->shutdown, memory_order_relaxed)) {
             break;
         }
-        local_gen = pool->generation;
-        pthread_mutex_unlock(&pool->mutex);
 
-        Strip *strip = &pool->strips[si];
-        bool wireframe = g_flags.show_wireframe;
-        for (int i = 0; i < strip->bucket_count; i++) {
-            const Chunk *chunk = strip->bucket[i];
-            if (wireframe) {
-                raster_wireframe_triangle(chunk, strip->x_start, strip->x_end);
-            } else {
-                switch (chunk->type) {
-                    case CHUNK_COLORED:
-                        raster_colored_triangle(chunk, strip->x_start, strip->x_end);
-                        break;
-                    case CHUNK_TEXTURED:
-                        raster_textured_triangle(chunk, strip->x_start, strip->x_end);
-                        break;
-                }
-            }
-        }
+        spin = pool->spin_limit;
+        pool->job(pool, pool->job_arg, si);
 
-        pthread_mutex_lock(&pool->mutex);
-        pool->workers_busy--;
-        if (pool->workers_busy == 0) {
-            pthread_cond_signal(&pool->cond_done);
+        // The last lane to finish releases the dispatcher
+        if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+            strip_wake_parked(pool, &pool->pending, &pool->dispatcher_parked);
         }
-        pthread_mutex_unlock(&pool->mutex);
     }
     return NULL;
 }
 
-void strip_pool_init(StripPool *pool, int num_strips) {
+void strip_pool_start(StripPool *pool, StripJobFunc job, void *arg) {
+    pool->job        = job;
+    pool->job_arg    = arg;
+    pool->spin_limit = g_flags.spin_dispatch ? STRIP_SPIN_LIMIT : 0;
+    atomic_store(&pool->pending, (uint32_t)(pool->thread_count - pool->first_thread));
+    atomic_fetch_add(&pool->generation, 1);
+    strip_wake_parked(pool, &pool->generation, &pool->workers_parked);
+}
+
+void strip_pool_wait(StripPool *pool) {
+    // An assisting dispatcher takes lane 0 itself rather than sleeping
+    if (pool->first_thread > 0) {
+        pool->job(pool, pool->job_arg, 0);
+    }
+
+    uint32_t left;
+    while ((left = atomic_load_explicit(&pool->pending, memory_order_acquire)) != 0) {
+        strip_await_change(pool, &pool->pending, left, &pool->dispatcher_parked, pool->spin_limit);
+    }
+}
+
+void strip_pool_run(StripPool *pool, StripJobFunc job, void *arg) {
+    strip_pool_start(pool, job, arg);
+    strip_pool_wait(pool);
+}
+
+int strip_pool_cpu_count(void) {
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        return clampi(CPU_COUNT(&set), 1, STRIP_MAX_THREADS);
+    }
+#endif
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 4 : (int)mini((int)n, STRIP_MAX_THREADS);
+}
+
+// Binds lane to the lane-th CPU of the affinity mask, wrapping around
+static void strip_pin_thread(pthread_t thread, int lane) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    int skip = lane % CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || skip-- > 0) continue;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        pthread_setaffinity_np(thread, sizeof(one), &one);
+        return;
+    }
+#else
+    (void)thread;
+    (void)lane;
+#endif
+}
+
+// Boundaries snap to whole cache lines of framebuffer row, which also keeps
+// raster tiles from straddling strips
+static void strip_pool_split_evenly(StripPool *pool) {
+    int n = pool->strip_count;
+    for (int i = 0; i < n; i++) {
+        int x_start = (i * WINDOW_WIDTH / n) & ~(STRIP_ALIGN - 1);
+        int x_end   = ((i + 1) * WINDOW_WIDTH / n) & ~(STRIP_ALIGN - 1);
+        pool->strips[i].x_start = x_start;
+        pool->strips[i].x_end   = (i == n - 1) ? WINDOW_WIDTH : x_end;
+    }
+}
+
+// Drops the lanes from lanes on, after their threads failed to start. With
+// none left the dispatcher takes lane 0 itself, as if assisting.
+static void strip_pool_shrink(StripPool *pool, int lanes) {
+    if (lanes == 0) {
+        pool->first_thread = 1;
+        lanes = 1;
+    }
+    for (int i = lanes; i < pool->thread_count; i++) {
+        StripBinner *b = &pool->binners[i];
+        free(b->counts);
+        free(b->cursors);
+        free(b->column_first);
+        free(b->column_last);
+        free(b->column_coverage);
+    }
+    pool->thread_count = lanes;
+    pool->strip_count  = lanes;
+    strip_pool_split_evenly(pool);
+}
+
+void strip_pool_init(StripPool *pool, int num_strips, bool main_assists, bool pin) {
+    pool->lanes_requested   = num_strips;
+    pool->assists_requested = main_assists;
     pool->strip_count  = num_strips;
+    pool->chunks       = NULL;
+    pool->bounds       = NULL;
+    pool->setups       = NULL;
+    pool->chunk_count  = 0;
+    pool->spill          = NULL;
+    pool->spill_capacity = 0;
+    pool->bucket_spills  = 0;
     pool->strips       = malloc(num_strips * sizeof(Strip));
     pool->thread_count = num_strips;
+    pool->first_thread = main_assists ? 1 : 0;
+    pool->pinned       = pin;
     pool->threads      = malloc(num_strips * sizeof(pthread_t));
-    pool->shutdown       = false;
-    pool->generation     = 0;
-    pool->workers_busy   = 0;
+    pool->job            = NULL;
+    pool->job_arg        = NULL;
+    pool->spin_limit     = 0;
+    atomic_init(&pool->generation, 0);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->workers_parked, 0);
+    atomic_init(&pool->dispatcher_parked, 0);
+    atomic_init(&pool->shutdown, false);
 
     pthread_mutex_init(&pool->mutex, NULL);
-    pthread_cond_init(&pool->cond_work, NULL);
-    pthread_cond_init(&pool->cond_done, NULL);
+    pthread_cond_init(&pool->cond, NULL);
 
-    int strip_width = WINDOW_WIDTH / num_strips;
+    strip_pool_split_evenly(pool);
     for (int i = 0; i < num_strips; i++) {
-        pool->strips[i].x_start      = i * strip_width;
-        pool->strips[i].x_end        = (i == num_strips - 1) ? WINDOW_WIDTH : (i + 1) * strip_width;
-        pool->strips[i].bucket       = malloc(MAX_STRIP_CHUNKS * sizeof(Chunk *));
+        pool->strips[i].y_start      = 0;
+        pool->strips[i].y_end        = WINDOW_HEIGHT;
+        pool->strips[i].bucket       = NULL;
         pool->strips[i].bucket_count = 0;
+        pool->strips[i].coverage     = 0;
+        pool->strips[i].render_time  = 0.0;
+        pool->strips[i].clear_time   = 0.0;
     }
+    pool->column_coverage = malloc(STRIP_COLUMNS * sizeof(int64_t));
 
-    for (int i = 0; i < num_strips; i++) {
+    pool->tiles_x    = (WINDOW_WIDTH  + STRIP_TILE_SIZE - 1) / STRIP_TILE_SIZE;
+    pool->tiles_y    = (WINDOW_HEIGHT + STRIP_TILE_SIZE - 1) / STRIP_TILE_SIZE;
+    pool->tile_count = pool->tiles_x * pool->tiles_y;
+    pool->tiles      = malloc(pool->tile_count * sizeof(Strip));
+    for (int tx = 0; tx < pool->tiles_x; tx++) {
+        for (int ty = 0; ty < pool->tiles_y; ty++) {
+            Strip *tile = &pool->tiles[tx * pool->tiles_y + ty];
+            tile->x_start      = tx * STRIP_TILE_SIZE;
+            tile->x_end        = mini((tx + 1) * STRIP_TILE_SIZE, WINDOW_WIDTH);
+            tile->y_start      = ty * STRIP_TILE_SIZE;
+            tile->y_end        = mini((ty + 1) * STRIP_TILE_SIZE, WINDOW_HEIGHT);
+            tile->bucket       = NULL;
+            tile->bucket_count = 0;
+            tile->coverage     = 0;
+            tile->render_time  = 0.0;
+            tile->clear_time   = 0.0;
+        }
+    }
+
+    pool->stealing    = false;
+    pool->clear       = false;
+    pool->clear_color = 0;
+    pool->queues   = aligned_alloc(_Alignof(StripQueue), pool->thread_count * sizeof(StripQueue));
+    for (int i = 0; i < pool->thread_count; i++) {
+        atomic_init(&pool->queues[i].range, 0);
+        pool->queues[i].render_time = 0.0;
+        pool->queues[i].clear_time  = 0.0;
+    }
+
+    int regions = maxi(pool->strip_count, pool->tile_count);
+    pool->binners = malloc(pool->thread_count * sizeof(StripBinner));
+    for (int i = 0; i < pool->thread_count; i++) {
+        StripBinner *b = &pool->binners[i];
+        b->counts          = malloc(regions * sizeof(int));
+        b->cursors         = malloc(regions * sizeof(int));
+        b->column_first    = malloc(STRIP_COLUMNS * sizeof(int));
+        b->column_last     = malloc(STRIP_COLUMNS * sizeof(int));
+        b->column_coverage = malloc(STRIP_COLUMNS * sizeof(int64_t));
+    }
+
+    for (int i = pool->first_thread; i < num_strips; i++) {
         WorkerArg *arg = malloc(sizeof(WorkerArg));
         arg->pool = pool;
         arg->strip_index = i;
-        pthread_create(&pool->threads[i], NULL, strip_worker_func, arg);
+        int err = pthread_create(&pool->threads[i], NULL, strip_worker_func, arg);
+        if (err != 0) {
+            free(arg);
+            fprintf(stderr, "Started %d of %d render lanes: %s\n", i, num_strips, strerror(err));
+            strip_pool_shrink(pool, i);
+            break;
+        }
+        if (pin) {
+            strip_pin_thread(pool->threads[i], i);
+        }
     }
 }
 
-void strip_pool_distribute(StripPool *pool, const Chunk *chunks, int chunk_count) {
+// Bounding box of a chunk clipped to the window, false if nothing is left
+static bool strip_chunk_rect(const StripPool *pool, int i, ScreenAABB *r) {
+    ChunkBounds b = pool->bounds[i];
+    *r = (ScreenAABB){ b.x_min, b.x_max, b.y_min, b.y_max };
+    return r->x_min < r->x_max && r->y_min < r->y_max;
+}
+
+// Tiles overlapped by a clipped rect, max inclusive
+static void strip_tile_range(ScreenAABB r, int *tx0, int *tx1, int *ty0, int *ty1) {
+    *tx0 = r.x_min / STRIP_TILE_SIZE;
+    *tx1 = (r.x_max - 1) / STRIP_TILE_SIZE;
+    *ty0 = r.y_min / STRIP_TILE_SIZE;
+    *ty1 = (r.y_max - 1) / STRIP_TILE_SIZE;
+}
+
+static void strip_bin_slice(const StripPool *pool, int worker, int *first, int *last) {
+    *first = (int)((int64_t)worker * pool->chunk_count / pool->thread_count);
+    *last  = (int)((int64_t)(worker + 1) * pool->chunk_count / pool->thread_count);
+}
+
+// Binning pass 1: count the chunks of this worker's slice per region. Strip
+// boundaries may still move, so strips are counted per column instead: how
+// many boxes start and end in each, and the pixels they cover there.
+//
+// Triangle setup for the slice rides along, so a chunk landing in several
+// regions is set up once rather than by each of them.
+static void strip_job_count(StripPool *pool, void *arg, int worker) {
+    StripBinner *b = &pool->binners[worker];
+    int first, last;
+    strip_bin_slice(pool, worker, &first, &last);
+
+    if (pool->setups) {
+        for (int i = first; i < last; i++) {
+            ScreenAABB r;
+            if (strip_chunk_rect(pool, i, &r)) raster_setup(&pool->chunks[i], &pool->setups[i]);
+        }
+    }
+
+    if (pool->stealing) {
+        memset(b->counts, 0, pool->tile_count * sizeof(int));
+        for (int i = first; i < last; i++) {
+            ScreenAABB r;
+            if (!strip_chunk_rect(pool, i, &r)) continue;
+            int tx0, tx1, ty0, ty1;
+            strip_tile_range(r, &tx0, &tx1, &ty0, &ty1);
+            for (int tx = tx0; tx <= tx1; tx++) {
+                for (int ty = ty0; ty <= ty1; ty++) {
+                    b->counts[tx * pool->tiles_y + ty]++;
+                }
+            }
+        }
+        return;
+    }
+
+    memset(b->column_first, 0, STRIP_COLUMNS * sizeof(int));
+    memset(b->column_last, 0, STRIP_COLUMNS * sizeof(int));
+    memset(b->column_coverage, 0, STRIP_COLUMNS * sizeof(int64_t));
+    for (int i = first; i < last; i++) {
+        ScreenAABB r;
+        if (!strip_chunk_rect(pool, i, &r)) continue;
+        int c0 = r.x_min / STRIP_ALIGN;
+        int c1 = (r.x_max - 1) / STRIP_ALIGN;
+        b->column_first[c0]++;
+        b->column_last[c1]++;
+
+        int height = r.y_max - r.y_min;
+        for (int c = c0; c <= c1; c++) {
+            int x0 = maxi(r.x_min, c * STRIP_ALIGN);
+            int x1 = mini(r.x_max, (c + 1) * STRIP_ALIGN);
+            b->column_coverage[c] += (int64_t)(x1 - x0) * height;
+        }
+    }
+}
+
+// Moves the strip boundaries so each strip's predicted cost is equal. The
+// cost of a column is this frame's bounding-box coverage there, weighted
+// by the seconds per covered pixel its owning strip measured last frame.
+static void strip_pool_balance(StripPool *pool) {
+    if (pool->strip_count > STRIP_COLUMNS) return;
+
+    double  total_time     = 0.0;
+    int64_t total_coverage = 0;
     for (int s = 0; s < pool->strip_count; s++) {
-        pool->strips[s].bucket_count = 0;
+        total_time     += pool->strips[s].render_time;
+        total_coverage += pool->strips[s].coverage;
+    }
+    if (total_time <= 0.0 || total_coverage == 0) return;
+    double fallback = total_time / (double)total_coverage;
+
+    double cost[STRIP_COLUMNS];
+    double total_cost = 0.0;
+    int    owner      = 0;
+    for (int c = 0; c < STRIP_COLUMNS; c++) {
+        while (owner < pool->strip_count - 1 && c * STRIP_ALIGN >= pool->strips[owner].x_end) {
+            owner++;
+        }
+        const Strip *strip = &pool->strips[owner];
+        double rate = strip->coverage > 0 ? strip->render_time / (double)strip->coverage : fallback;
+        cost[c]     = rate * (double)pool->column_coverage[c];
+        total_cost += cost[c];
     }
+    if (total_cost <= 0.0) return;
+
+    // Walk the prefix sum, cutting where each share of the total is reached.
+    // Moving halfway there keeps timer noise from making boundaries jitter.
+    double sum = 0.0;
+    int    c   = 0;
+    for (int s = 0; s < pool->strip_count - 1; s++) {
+        double target = total_cost * (double)(s + 1) / (double)pool->strip_count;
+        while (c < STRIP_COLUMNS && sum + cost[c] <= target) {
+            sum += cost[c++];
+        }
+        int ideal = (c < STRIP_COLUMNS && sum + cost[c] - target < target - sum) ? c + 1 : c;
+        int old   = pool->strips[s].x_end / STRIP_ALIGN;
+        int cut   = ideal > old ? (old + ideal + 1) / 2 : (old + ideal) / 2;
+        cut = clampi(cut, s + 1, STRIP_COLUMNS - (pool->strip_count - 1 - s));
+        if (s > 0) cut = maxi(cut, pool->strips[s - 1].x_end / STRIP_ALIGN + 1);
 
-    for (int i = 0; i < chunk_count; i++) {
-        ScreenAABB bb = chunk_screen_aabb(&chunks[i]);
+        pool->strips[s].x_end       = cut * STRIP_ALIGN;
+        pool->strips[s + 1].x_start = cut * STRIP_ALIGN;
+    }
+}
 
-        if (bb.x_max < 0 || bb.x_min >= WINDOW_WIDTH ||
-            bb.y_max < 0 || bb.y_min >= WINDOW_HEIGHT) {
-            continue;
+// Settles this frame's strip boundaries from the column counts, then turns
+// them into per-worker strip counts. A box overlaps columns [a, b) when it
+// starts before b and does not end before a.
+static void strip_pool_fit_strips(StripPool *pool) {
+    memset(pool->column_coverage, 0, STRIP_COLUMNS * sizeof(int64_t));
+    for (int t = 0; t < pool->thread_count; t++) {
+        const StripBinner *b = &pool->binners[t];
+        for (int c = 0; c < STRIP_COLUMNS; c++) {
+            pool->column_coverage[c] += b->column_coverage[c];
         }
+    }
 
+    if (g_flags.balance_strips) {
+        strip_pool_balance(pool);
+    } else {
+        strip_pool_split_evenly(pool);
+    }
+
+    for (int s = 0; s < pool->strip_count; s++) {
+        Strip *strip = &pool->strips[s];
+        strip->coverage = 0;
+        for (int c = strip->x_start / STRIP_ALIGN; c * STRIP_ALIGN < strip->x_end; c++) {
+            strip->coverage += pool->column_coverage[c];
+        }
+    }
+
+    for (int t = 0; t < pool->thread_count; t++) {
+        StripBinner *b = &pool->binners[t];
+        for (int c = 1; c < STRIP_COLUMNS; c++) {
+            b->column_first[c] += b->column_first[c - 1];
+            b->column_last[c]  += b->column_last[c - 1];
+        }
         for (int s = 0; s < pool->strip_count; s++) {
-            Strip *strip = &pool->strips[s];
-            if (bb.x_min < strip->x_end && bb.x_max > strip->x_start) {
-                if (strip->bucket_count < MAX_STRIP_CHUNKS) {
-                    strip->bucket[strip->bucket_count++] = &chunks[i];
+            int a  = pool->strips[s].x_start / STRIP_ALIGN;
+            int bc = (pool->strips[s].x_end + STRIP_ALIGN - 1) / STRIP_ALIGN;
+            int starts_before = bc > 0 ? b->column_first[bc - 1] : 0;
+            int ends_before   = a  > 0 ? b->column_last[a - 1]   : 0;
+            b->counts[s] = starts_before - ends_before;
+        }
+    }
+}
+
+// Each worker starts with a contiguous run of columns, roughly its strip
+static void strip_pool_reset_queues(StripPool *pool) {
+    for (int i = 0; i < pool->thread_count; i++) {
+        StripQueue *q = &pool->queues[i];
+        uint32_t head = (uint32_t)((int64_t)i * pool->tile_count / pool->thread_count);
+        uint32_t tail = (uint32_t)((int64_t)(i + 1) * pool->tile_count / pool->thread_count);
+        atomic_store_explicit(&q->range, queue_range(head, tail), memory_order_relaxed);
+        q->tiles_rendered  = 0;
+        q->tiles_stolen    = 0;
+        q->chunks_rendered = 0;
+        q->render_time     = 0.0;
+        q->clear_time      = 0.0;
+    }
+}
+
+// Room for every bucket entry of the frame, from the arena when it fits.
+// Otherwise the pool's own heap buffer takes them, so nothing is dropped,
+// and the spill is counted for the HUD.
+static uint32_t *strip_pool_bucket_storage(StripPool *pool, Arena *arena, size_t entries) {
+    uint32_t *storage = arena_try_alloc(arena, entries * sizeof(uint32_t));
+    if (storage) return storage;
+
+    pool->bucket_spills++;
+    if (entries > pool->spill_capacity) {
+        size_t capacity = entries + entries / 2;
+        uint32_t *spill = realloc(pool->spill, capacity * sizeof(uint32_t));
+        if (!spill) return NULL;
+        pool->spill          = spill;
+        pool->spill_capacity = capacity;
+    }
+    return pool->spill;
+}
+
+// Prefix sum over the workers' counts: each slice gets its own run of
+// every bucket, in slice order, so the buckets stay sorted front to back.
+// Returns false, with every bucket left empty, when no storage was found.
+static bool strip_pool_assign_cursors(StripPool *pool, Arena *arena) {
+    int    region_count = pool->stealing ? pool->tile_count : pool->strip_count;
+    Strip *regions      = pool->stealing ? pool->tiles : pool->strips;
+    size_t entries      = 0;
+    for (int r = 0; r < region_count; r++) {
+        int pos = 0;
+        for (int t = 0; t < pool->thread_count; t++) {
+            pool->binners[t].cursors[r] = pos;
+            pos += pool->binners[t].counts[r];
+        }
+        regions[r].bucket_count = pos;
+        entries += (size_t)pos;
+    }
+
+    uint32_t *storage = strip_pool_bucket_storage(pool, arena, entries);
+    for (int r = 0; r < region_count; r++) {
+        if (!storage) regions[r].bucket_count = 0;
+        regions[r].bucket = storage;
+        if (storage) storage += regions[r].bucket_count;
+    }
+    return storage != NULL;
+}
+
+static inline void strip_bin_append(Strip *region, int *cursor, uint32_t index) {
+    region->bucket[(*cursor)++] = index;
+}
+
+// Binning pass 2: write this worker's slice into the runs it was given
+static void strip_job_scatter(StripPool *pool, void *arg, int worker) {
+    StripBinner *b = &pool->binners[worker];
+    int first, last;
+    strip_bin_slice(pool, worker, &first, &last);
+
+    for (int i = first; i < last; i++) {
+        ScreenAABB r;
+        if (!strip_chunk_rect(pool, i, &r)) continue;
+
+        if (pool->stealing) {
+            int tx0, tx1, ty0, ty1;
+            strip_tile_range(r, &tx0, &tx1, &ty0, &ty1);
+            for (int tx = tx0; tx <= tx1; tx++) {
+                for (int ty = ty0; ty <= ty1; ty++) {
+                    int t = tx * pool->tiles_y + ty;
+                    strip_bin_append(&pool->tiles[t], &b->cursors[t], (uint32_t)i);
+                }
+            }
+        } else {
+            for (int s = 0; s < pool->strip_count; s++) {
+                Strip *strip = &pool->strips[s];
+                if (r.x_min < strip->x_end && r.x_max > strip->x_start) {
+                    strip_bin_append(strip, &b->cursors[s], (uint32_t)i);
                 }
             }
         }
     }
 }
 
-void strip_pool_render(StripPool *pool) {
-    pthread_mutex_lock(&pool->mutex);
-    pool->workers_busy = pool->thread_count;
-    pool->generation++;
-    pthread_cond_broadcast(&pool->cond_work);
-    pthread_mutex_unlock(&pool->mutex);
+void strip_pool_distribute(StripPool *pool, const ChunkStream *stream, Arena *arena) {
+    pool->chunks      = stream->chunks;
+    pool->bounds      = stream->bounds;
+    pool->chunk_count = stream->count;
+    pool->stealing    = g_flags.work_stealing;
 
-    pthread_mutex_lock(&pool->mutex);
-    while (pool->workers_busy > 0) {
-        pthread_cond_wait(&pool->cond_done, &pool->mutex);
+    pool->setups = arena_try_alloc(arena, (size_t)stream->count * sizeof(RasterSetup));
+
+    strip_pool_run(pool, strip_job_count, NULL);
+    if (pool->stealing) {
+        strip_pool_reset_queues(pool);
+    } else {
+        strip_pool_fit_strips(pool);
+    }
+    if (strip_pool_assign_cursors(pool, arena)) {
+        strip_pool_run(pool, strip_job_scatter, NULL);
     }
-    pthread_mutex_unlock(&pool->mutex);
 }
 
-void strip_pool_destroy(StripPool *pool) {
-    pthread_mutex_lock(&pool->mutex);
-    pool->shutdown = true;
-    pthread_cond_broadcast(&pool->cond_work);
-    pthread_mutex_unlock(&pool->mutex);
+static void strip_job_render(StripPool *pool, void *arg, int worker) {
+    if (pool->stealing) {
+        StripQueue *own = &pool->queues[worker];
+        double t0 = timing_now();
+        int tile;
+        while ((tile = strip_pool_claim(pool, worker)) >= 0) {
+            own->clear_time += strip_render(pool, &pool->tiles[tile]);
+            own->tiles_rendered++;
+            own->chunks_rendered += pool->tiles[tile].bucket_count;
+        }
+        own->render_time = timing_now() - t0;
+    } else {
+        Strip *strip = &pool->strips[worker];
+        double t0 = timing_now();
+        strip->clear_time  = strip_render(pool, strip);
+        strip->render_time = timing_now() - t0;
+    }
+}
 
+double strip_pool_busiest_lane(const StripPool *pool, double *clear_time) {
+    double busiest = 0.0, busiest_clear = 0.0;
     for (int i = 0; i < pool->thread_count; i++) {
+        double t = pool->stealing ? pool->queues[i].render_time : pool->strips[i].render_time;
+        if (t > busiest) {
+            busiest       = t;
+            busiest_clear = pool->stealing ? pool->queues[i].clear_time : pool->strips[i].clear_time;
+        }
+    }
+    if (clear_time) *clear_time = busiest_clear;
+    return busiest;
+}
+
+void strip_pool_render(StripPool *pool) {
+    strip_pool_run(pool, strip_job_render, NULL);
+}
+
+void strip_pool_set_clear(StripPool *pool, bool clear, uint32_t color) {
+    pool->clear       = clear;
+    pool->clear_color = color;
+}
+
+void strip_pool_render_start(StripPool *pool) {
+    strip_pool_start(pool, strip_job_render, NULL);
+}
+
+void strip_pool_destroy(StripPool *pool) {
+    atomic_store(&pool->shutdown, true);
+    atomic_fetch_add(&pool->generation, 1);
+    strip_wake(pool, &pool->generation);
+
+    for (int i = pool->first_thread; i < pool->thread_count; i++) {
         pthread_join(pool->threads[i], NULL);
     }
 
-    for (int i = 0; i < pool->strip_count; i++) {
-        free(pool->strips[i].bucket);
+    for (int i = 0; i < pool->thread_count; i++) {
+        StripBinner *b = &pool->binners[i];
+        free(b->counts);
+        free(b->cursors);
+        free(b->column_first);
+        free(b->column_last);
+        free(b->column_coverage);
     }
     free(pool->strips);
+    free(pool->column_coverage);
+    free(pool->tiles);
+    free(pool->queues);
+    free(pool->binners);
+    free(pool->spill);
     free(pool->threads);
 
     pthread_mutex_destroy(&pool->mutex);
-    pthread_cond_destroy(&pool->cond_work);
-    pthread_cond_destroy(&pool->cond_done);
+    pthread_cond_destroy(&pool->cond);
 }
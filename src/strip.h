@@ -2,35 +2,129 @@
 #define STRIP_H
 
 #include "chunk.h"
+#include "raster.h"
+#include "arena.h"
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 
-#define MAX_STRIP_CHUNKS 8192
+// Upper bound on worker lanes, matching the CPUs an affinity mask can name
+#define STRIP_MAX_THREADS 1024
 
+// Pause-loop iterations a waiting thread spins before parking, when
+// spinning is on
+#define STRIP_SPIN_LIMIT 4096
+
+// In work-stealing mode the screen is cut into square tiles of this size,
+// many more than there are threads
+#define STRIP_TILE_SIZE 64
+
+// Balanced strip boundaries move in whole cache lines of framebuffer row
+#define STRIP_ALIGN (64 / (int)sizeof(uint32_t))
+#define STRIP_COLUMNS ((WINDOW_WIDTH + STRIP_ALIGN - 1) / STRIP_ALIGN)
+
+// A screen region with the chunks overlapping it: either a full-height
+// strip or a tile. Buckets hold indices into the pool's chunk array and
+// are carved out of one per-frame allocation, sized from the counts.
 typedef struct {
-    int           x_start;
-    int           x_end;
-    const Chunk **bucket;
-    int           bucket_count;
+    int       x_start, x_end;
+    int       y_start, y_end;
+    uint32_t *bucket;
+    int       bucket_count;
+    int64_t   coverage;     // bucket bounding-box pixels inside the region
+    double    render_time;  // seconds the worker spent on it last frame
+    double    clear_time;   // the part of render_time spent clearing it
 } Strip;
 
+// The tiles a worker has left this frame, as a range of tile indices the
+// owner takes from the front and thieves take from the back. Head and
+// tail share one word so either end moves with a single compare-and-swap.
+typedef struct {
+    _Alignas(64) _Atomic uint64_t range;  // head in the low half, tail in the high
+    int tiles_rendered;
+    int tiles_stolen;
+    int chunks_rendered;
+    double render_time;  // seconds from the first tile claimed to the last done
+    double clear_time;   // the part of render_time spent clearing tiles
+} StripQueue;
+
+// A worker's share of binning, over its slice of the sorted chunk array.
+// Strip counts come from the per-column arrays once boundaries are known.
 typedef struct {
+    int     *counts;           // chunks per strip or tile
+    int     *cursors;          // where the slice's run in each bucket starts
+    int     *column_first;     // boxes starting in each STRIP_ALIGN column
+    int     *column_last;      // boxes ending in each column
+    int64_t *column_coverage;  // box pixels in each column
+} StripBinner;
+
+typedef struct StripPool StripPool;
+typedef void (*StripJobFunc)(StripPool *pool, void *arg, int worker);
+
+struct StripPool {
     pthread_t      *threads;
-    int             thread_count;
-    Strip          *strips;
+    int             thread_count; // lanes, including one run by the dispatcher
+    int             first_thread; // 1 when the dispatcher runs lane 0 itself
+    bool            pinned;       // each worker bound to one CPU
+    int             lanes_requested;    // thread_count is less if threads failed to start
+    bool            assists_requested;  // first_thread is 1 regardless if none started
+    Strip          *strips;   // one full-height strip per thread
     int             strip_count;
+    Strip          *tiles;    // column-major, so queue ranges run down columns
+    int             tile_count;
+    int             tiles_x, tiles_y;
+    StripQueue     *queues;   // one per thread
+    bool            stealing; // mode the current frame was distributed for
+    bool            clear;    // regions clear themselves before rendering
+    uint32_t        clear_color;
+    const Chunk    *chunks;   // array the bucket indices refer to
+    const ChunkBounds *bounds;  // the only per-chunk data binning reads
+    RasterSetup    *setups;   // per chunk, or NULL when the arena was short
+    int             chunk_count;
+    uint32_t       *spill;    // bucket storage when the frame arena runs out
+    size_t          spill_capacity;
+    int             bucket_spills;  // frames whose buckets did not fit the arena
+    StripBinner    *binners;  // one per thread
+    int64_t        *column_coverage;  // per STRIP_ALIGN columns, this frame
+
+    StripJobFunc    job;      // what the workers run on the next generation
+    void           *job_arg;
+    int             spin_limit;
+
+    // Dispatch: bumping generation publishes a job, and the last lane to
+    // finish brings pending to zero. Waiters on either spin, then park.
+    _Alignas(64) _Atomic uint32_t generation;
+    _Alignas(64) _Atomic uint32_t pending;
+    _Atomic uint32_t workers_parked;     // on generation, or about to be
+    _Atomic uint32_t dispatcher_parked;  // on pending
+    _Atomic bool     shutdown;
 
-    pthread_mutex_t mutex;
-    pthread_cond_t  cond_work;
-    pthread_cond_t  cond_done;
-    int             workers_busy;
-    int             generation;
-    bool            shutdown;
-} StripPool;
+    pthread_mutex_t mutex;    // parking where futexes are unavailable
+    pthread_cond_t  cond;
+};
 
-void strip_pool_init(StripPool *pool, int num_strips);
-void strip_pool_distribute(StripPool *pool, const Chunk *chunks, int chunk_count);
+// CPUs this process may run on, from its affinity mask where available
+int  strip_pool_cpu_count(void);
+// With main_assists the calling thread runs lane 0 inside strip_pool_wait()
+// and only num_strips - 1 threads are started. With pin, each worker is
+// bound to one CPU of the affinity mask (Linux only).
+void strip_pool_init(StripPool *pool, int num_strips, bool main_assists, bool pin);
+// Bins the stream's chunks into buckets allocated from arena, which must
+// outlive the render, as must the stream. Buckets that do not fit spill
+// to the heap and bump bucket_spills.
+void strip_pool_distribute(StripPool *pool, const ChunkStream *stream, Arena *arena);
+// Has each region clear its color and depth before rendering it
+void strip_pool_set_clear(StripPool *pool, bool clear, uint32_t color);
 void strip_pool_render(StripPool *pool);
+// Starts rendering and returns at once; strip_pool_wait() joins it
+void strip_pool_render_start(StripPool *pool);
+// Seconds the slowest lane spent rendering the last frame. clear_time, if
+// not NULL, gets how much of that went to clearing its regions.
+double strip_pool_busiest_lane(const StripPool *pool, double *clear_time);
+// Runs job(pool, arg, worker) once on every worker and waits for all of them
+void strip_pool_run(StripPool *pool, StripJobFunc job, void *arg);
+void strip_pool_start(StripPool *pool, StripJobFunc job, void *arg);
+void strip_pool_wait(StripPool *pool);
 void strip_pool_destroy(StripPool *pool);
 
 #endif // STRIP_H
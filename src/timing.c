@@ -0,0 +1,77 @@
+#include "timing.h"
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *stage_names[TIMING_STAGE_COUNT] = {
+    [TIMING_INPUT]      = "input",
+    [TIMING_PHYSICS]    = "physics",
+    [TIMING_CHUNKS]     = "chunks",
+    [TIMING_SORT]       = "sort",
+    [TIMING_DISTRIBUTE] = "distribute",
+    [TIMING_CLEAR]      = "clear",
+    [TIMING_RENDER]     = "render",
+    [TIMING_RASTER_MAX] = "raster max",
+    [TIMING_OVERLAYS]   = "overlays",
+    [TIMING_PRESENT]    = "present",
+    [TIMING_FRAME]      = "frame",
+};
+
+// Monotonic, so clock steps cannot make a stage negative
+double timing_now(void) {
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+const char *timing_stage_name(TimingStage stage) {
+    return stage_names[stage];
+}
+
+void timing_init(FrameTimings *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+void timing_begin_frame(FrameTimings *t) {
+    memset(t->current, 0, sizeof(t->current));
+    t->frame_start = timing_now();
+}
+
+double timing_mark(FrameTimings *t, TimingStage stage, double start) {
+    double now = timing_now();
+    t->current[stage] += now - start;
+    return now;
+}
+
+void timing_set(FrameTimings *t, TimingStage stage, double seconds) {
+    t->current[stage] = seconds;
+}
+
+void timing_end_frame(FrameTimings *t) {
+    t->current[TIMING_FRAME] = timing_now() - t->frame_start;
+    for (int s = 0; s < TIMING_STAGE_COUNT; s++) {
+        t->history[s][t->head] = t->current[s];
+    }
+    t->head = (t->head + 1) % TIMING_HISTORY;
+    if (t->count < TIMING_HISTORY) t->count++;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+TimingStats timing_stats(const FrameTimings *t, TimingStage stage) {
+    TimingStats stats = {0};
+    if (t->count == 0) return stats;
+
+    // Slot order does not matter for any of the three
+    double sorted[TIMING_HISTORY];
+    memcpy(sorted, t->history[stage], t->count * sizeof(double));
+    qsort(sorted, t->count, sizeof(double), compare_double);
+
+    double sum = 0.0;
+    for (int i = 0; i < t->count; i++) sum += sorted[i];
+    stats.min = sorted[0];
+    stats.avg = sum / t->count;
+    stats.p99 = sorted[(t->count * 99) / 100];
+    return stats;
+}
@@ -0,0 +1,50 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+// Frames of history kept per stage for the breakdown overlay
+#define TIMING_HISTORY 256
+
+typedef enum {
+    TIMING_INPUT,
+    TIMING_PHYSICS,
+    TIMING_CHUNKS,
+    TIMING_SORT,
+    TIMING_DISTRIBUTE,
+    TIMING_CLEAR,
+    TIMING_RENDER,      // main thread running or waiting on the workers
+    TIMING_RASTER_MAX,  // busiest worker lane
+    TIMING_OVERLAYS,
+    TIMING_PRESENT,
+    TIMING_FRAME,       // whole loop iteration
+    TIMING_STAGE_COUNT,
+} TimingStage;
+
+// Stage times accumulate into current over one loop iteration, then
+// timing_end_frame() moves them into the ring
+typedef struct {
+    double current[TIMING_STAGE_COUNT];
+    double history[TIMING_STAGE_COUNT][TIMING_HISTORY];
+    int    head;   // next slot to write
+    int    count;  // filled slots
+    double frame_start;
+} FrameTimings;
+
+typedef struct {
+    double min, avg, p99;
+} TimingStats;
+
+// Seconds on a clock only meaningful as differences
+double timing_now(void);
+const char *timing_stage_name(TimingStage stage);
+
+void timing_init(FrameTimings *t);
+void timing_begin_frame(FrameTimings *t);
+// Adds the seconds since start to a stage and returns the current time,
+// so consecutive stages can chain their marks
+double timing_mark(FrameTimings *t, TimingStage stage, double start);
+void timing_set(FrameTimings *t, TimingStage stage, double seconds);
+void timing_end_frame(FrameTimings *t);
+// Over the frames in the ring; all zero before the first one
+TimingStats timing_stats(const FrameTimings *t, TimingStage stage);
+
+#endif // TIMING_H